@@ -1,5 +1,7 @@
 #version 460
 
+#define CHUNK_SIZE 16
+
 layout(location = 0) in uint positionAndTexCoords;
 layout(location = 1) in float texIdx;
 
@@ -13,8 +15,13 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
     float dayTime;
 } ubo;
 
+// Позиции чанков отрисовок; firstInstance команды - номер позиции её чанка
+layout(std430, set = 1, binding = 0) readonly buffer ChunkDraws {
+    ivec2 chunkPositions[];
+};
+
 layout(push_constant) uniform Push {
-    vec2 chunkPos;
+    ivec2 playerChunk;
 } push;
 
 vec3 decompressPos(uint pos) {
@@ -26,7 +33,9 @@ vec3 decompressTexCoords(uint pos, float texIdx) {
 }
 
 void main() {
-    vec4 worldPos = vec4(push.chunkPos.x, 0.0, push.chunkPos.y, 0.0) + vec4(decompressPos(positionAndTexCoords), 1.0);
+    // Координаты относительно чанка игрока: абсолютные не влезли бы в точность float
+    vec2 chunkPos = vec2(chunkPositions[gl_InstanceIndex] - push.playerChunk) * CHUNK_SIZE;
+    vec4 worldPos = vec4(chunkPos.x, 0.0, chunkPos.y, 0.0) + vec4(decompressPos(positionAndTexCoords), 1.0);
     gl_Position = ubo.projectionView * worldPos;
     fragTexCoord = decompressTexCoords(positionAndTexCoords, texIdx);
 }
\ No newline at end of file
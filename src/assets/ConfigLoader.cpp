@@ -0,0 +1,34 @@
+#include "ConfigLoader.hpp"
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+Config ConfigLoader::load(const std::filesystem::path &filePath) {
+  Config config;
+  std::ifstream f(filePath);
+  if (!f.is_open()) {
+    return config;
+  }
+  nlohmann::json configData = nlohmann::json::parse(f);
+  if (configData.contains("render_distance")) {
+    config.renderDistance = configData["render_distance"];
+  }
+  if (configData.contains("memory_budget_mb")) {
+    config.memoryBudgetMb = configData["memory_budget_mb"];
+  }
+  if (configData.contains("prefetch_seconds")) {
+    config.prefetchSeconds = configData["prefetch_seconds"];
+  }
+  if (configData.contains("prefetch_meshing")) {
+    config.prefetchMeshing = configData["prefetch_meshing"];
+  }
+  if (configData.contains("retention_distance")) {
+    config.retentionDistance = configData["retention_distance"];
+  }
+  if (configData.contains("retention_seconds")) {
+    config.retentionSeconds = configData["retention_seconds"];
+  }
+  if (configData.contains("gpu_culling")) {
+    config.gpuCulling = configData["gpu_culling"];
+  }
+  return config;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+struct Config {
+  int renderDistance = 32;
+  // 0 - без ограничения
+  size_t memoryBudgetMb = 0;
+  // На сколько секунд движения вперёд подгружаются чанки, 0 - без предзагрузки
+  float prefetchSeconds = 1.5f;
+  bool prefetchMeshing = false;
+  // Покинувшие радиус чанки держатся ещё столько чанков и секунд, чтобы не перегенерировать их на границе
+  int retentionDistance = 4;
+  float retentionSeconds = 10.0f;
+  // Отсечение секций чанков компьют-шейдером, без обхода пещер; false - на CPU, с обходом пещер
+  bool gpuCulling = false;
+};
+
+class ConfigLoader {
+public:
+  // Отсутствующий файл или поле заменяются значениями по умолчанию
+  static Config load(const std::filesystem::path &filePath);
+};
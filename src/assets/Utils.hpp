@@ -39,4 +39,6 @@ static std::filesystem::path getResourcesPath() { return getExecutableDir() / "r
 
 static std::filesystem::path getBlocksPath() { return getResourcesPath() / "blocks"; }
 
-static std::filesystem::path getTexturesPath() { return getResourcesPath() / "textures"; }
\ No newline at end of file
+static std::filesystem::path getTexturesPath() { return getResourcesPath() / "textures"; }
+
+static std::filesystem::path getConfigPath() { return getResourcesPath() / "config.json"; }
\ No newline at end of file
@@ -49,6 +49,7 @@ void App::run() {
     }
 
     if (auto commandBuffer = m_renderer->beginFrame()) {
+      m_scene->preRender(commandBuffer);
       m_renderer->beginSwapChainRenderPass(commandBuffer);
       m_scene->render(commandBuffer);
       {
@@ -56,6 +57,7 @@ void App::run() {
         ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
       }
       m_renderer->endSwapChainRenderPass(commandBuffer);
+      m_scene->postRender(commandBuffer);
       m_renderer->endFrame();
     }
   }
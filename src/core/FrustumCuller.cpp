@@ -0,0 +1,128 @@
+#include "FrustumCuller.hpp"
+#include <array>
+#include <bit>
+#include <tracy/Tracy.hpp>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+constexpr size_t PLANES_COUNT = 6;
+
+// Плоскость и указатели на координаты её p-вершины для всех боксов
+struct CullPlane {
+  glm::vec4 plane;
+  const float *x;
+  const float *y;
+  const float *z;
+};
+} // namespace
+
+void FrustumCuller::reserve(size_t count) {
+  m_minX.reserve(count);
+  m_minY.reserve(count);
+  m_minZ.reserve(count);
+  m_maxX.reserve(count);
+  m_maxY.reserve(count);
+  m_maxZ.reserve(count);
+}
+
+void FrustumCuller::cull(const Frustum &frustum, std::vector<uint32_t> &visible) const {
+  ZoneScoped;
+  visible.clear();
+  const size_t count = size();
+  // Знак нормали одинаков для всех боксов, поэтому выбор p-вершины делается один раз на плоскость
+  std::array<CullPlane, PLANES_COUNT> planes;
+  for (size_t i = 0; i < PLANES_COUNT; i++) {
+    const glm::vec4 &plane = frustum.getPlanes()[i];
+    planes[i] = {
+        .plane = plane,
+        .x = plane.x > 0.0f ? m_maxX.data() : m_minX.data(),
+        .y = plane.y > 0.0f ? m_maxY.data() : m_minY.data(),
+        .z = plane.z > 0.0f ? m_maxZ.data() : m_minZ.data(),
+    };
+  }
+
+  size_t i = 0;
+#if defined(__AVX__)
+  constexpr size_t BATCH_SIZE = 8;
+  const __m256 zero = _mm256_setzero_ps();
+  for (; i + BATCH_SIZE <= count; i += BATCH_SIZE) {
+    int mask = (1 << BATCH_SIZE) - 1;
+    for (const auto &[plane, x, y, z] : planes) {
+      __m256 distance = _mm256_mul_ps(_mm256_set1_ps(plane.x), _mm256_loadu_ps(x + i));
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.y), _mm256_loadu_ps(y + i)));
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.z), _mm256_loadu_ps(z + i)));
+      distance = _mm256_add_ps(distance, _mm256_set1_ps(plane.w));
+      mask &= _mm256_movemask_ps(_mm256_cmp_ps(distance, zero, _CMP_GT_OQ));
+      if (mask == 0) {
+        break;
+      }
+    }
+    for (; mask != 0; mask &= mask - 1) {
+      visible.push_back(static_cast<uint32_t>(i + std::countr_zero(static_cast<unsigned>(mask))));
+    }
+  }
+#elif defined(__SSE2__)
+  constexpr size_t BATCH_SIZE = 4;
+  const __m128 zero = _mm_setzero_ps();
+  for (; i + BATCH_SIZE <= count; i += BATCH_SIZE) {
+    int mask = (1 << BATCH_SIZE) - 1;
+    for (const auto &[plane, x, y, z] : planes) {
+      __m128 distance = _mm_mul_ps(_mm_set1_ps(plane.x), _mm_loadu_ps(x + i));
+      distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.y), _mm_loadu_ps(y + i)));
+      distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.z), _mm_loadu_ps(z + i)));
+      distance = _mm_add_ps(distance, _mm_set1_ps(plane.w));
+      mask &= _mm_movemask_ps(_mm_cmpgt_ps(distance, zero));
+      if (mask == 0) {
+        break;
+      }
+    }
+    for (; mask != 0; mask &= mask - 1) {
+      visible.push_back(static_cast<uint32_t>(i + std::countr_zero(static_cast<unsigned>(mask))));
+    }
+  }
+#endif
+  // Хвост, не кратный размеру пачки
+  for (; i < count; i++) {
+    bool isVisible = true;
+    for (const auto &[plane, x, y, z] : planes) {
+      if (plane.x * x[i] + plane.y * y[i] + plane.z * z[i] + plane.w <= 0.0f) {
+        isVisible = false;
+        break;
+      }
+    }
+    if (isVisible) {
+      visible.push_back(static_cast<uint32_t>(i));
+    }
+  }
+}
+
+bool FrustumCuller::isBoxVisible(const Frustum &frustum, const glm::vec3 &min, const glm::vec3 &max) noexcept {
+  for (size_t i = 0; i < PLANES_COUNT; i++) {
+    const glm::vec4 &plane = frustum.getPlanes()[i];
+    const float x = plane.x > 0.0f ? max.x : min.x;
+    const float y = plane.y > 0.0f ? max.y : min.y;
+    const float z = plane.z > 0.0f ? max.z : min.z;
+    if (plane.x * x + plane.y * y + plane.z * z + plane.w <= 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool FrustumCuller::isBoxInside(const Frustum &frustum, const glm::vec3 &min, const glm::vec3 &max) noexcept {
+  for (size_t i = 0; i < PLANES_COUNT; i++) {
+    const glm::vec4 &plane = frustum.getPlanes()[i];
+    const float x = plane.x > 0.0f ? min.x : max.x;
+    const float y = plane.y > 0.0f ? min.y : max.y;
+    const float z = plane.z > 0.0f ? min.z : max.z;
+    if (plane.x * x + plane.y * y + plane.z * z + plane.w <= 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
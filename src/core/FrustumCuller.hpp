@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Frustum.hpp"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Отсечение AABB по пирамиде видимости пачками: по 8 боксов с AVX, по 4 с SSE.
+// Боксы хранятся как SoA, для каждой плоскости проверяется только p-вершина -
+// угол бокса, дальше всех продвинутый вдоль нормали плоскости.
+class FrustumCuller {
+public:
+  inline void clear() noexcept {
+    m_minX.clear();
+    m_minY.clear();
+    m_minZ.clear();
+    m_maxX.clear();
+    m_maxY.clear();
+    m_maxZ.clear();
+  }
+  void reserve(size_t count);
+  // Возвращает индекс бокса, по которому он попадёт в результат cull
+  inline uint32_t addBox(const glm::vec3 &min, const glm::vec3 &max) {
+    m_minX.push_back(min.x);
+    m_minY.push_back(min.y);
+    m_minZ.push_back(min.z);
+    m_maxX.push_back(max.x);
+    m_maxY.push_back(max.y);
+    m_maxZ.push_back(max.z);
+    return static_cast<uint32_t>(m_minX.size() - 1);
+  }
+  inline size_t size() const noexcept { return m_minX.size(); }
+
+  // Записывает в visible индексы боксов, хотя бы частично попадающих в пирамиду, по возрастанию
+  void cull(const Frustum &frustum, std::vector<uint32_t> &visible) const;
+  // Проверка одного бокса без SIMD, для обходов, где боксы появляются по одному
+  static bool isBoxVisible(const Frustum &frustum, const glm::vec3 &min, const glm::vec3 &max) noexcept;
+  // Бокс целиком внутри пирамиды: по каждой плоскости проверяется n-вершина, противоположная p-вершине
+  static bool isBoxInside(const Frustum &frustum, const glm::vec3 &min, const glm::vec3 &max) noexcept;
+
+private:
+  std::vector<float> m_minX;
+  std::vector<float> m_minY;
+  std::vector<float> m_minZ;
+  std::vector<float> m_maxX;
+  std::vector<float> m_maxY;
+  std::vector<float> m_maxZ;
+};
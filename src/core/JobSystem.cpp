@@ -0,0 +1,142 @@
+#include "JobSystem.hpp"
+#include <algorithm>
+#include <tracy/Tracy.hpp>
+
+namespace {
+constexpr size_t NOT_A_WORKER = static_cast<size_t>(-1);
+thread_local size_t currentWorkerIdx = NOT_A_WORKER;
+} // namespace
+
+JobSystem::JobSystem(int workersCount) {
+  ZoneScoped;
+  const size_t count = static_cast<size_t>(std::max(1, workersCount));
+  m_workers.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    m_workers.push_back(std::make_unique<Worker>());
+  }
+  for (size_t i = 0; i < count; i++) {
+    m_workers[i]->thread = std::thread([this, i]() { workerLoop(i); });
+  }
+}
+
+JobSystem::~JobSystem() {
+  ZoneScoped;
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    m_isRunning.store(false);
+  }
+  m_sleepCondition.notify_all();
+  for (auto &worker : m_workers) {
+    worker->thread.join();
+  }
+}
+
+JobHandle JobSystem::submit(std::function<void()> func, std::span<const JobHandle> dependencies) {
+  ZoneScoped;
+  auto job = std::make_shared<Job>(std::move(func));
+  for (const auto &dependency : dependencies) {
+    if (!dependency) {
+      continue;
+    }
+    if (dependency->isCancelled()) {
+      job->cancel();
+    }
+    std::lock_guard<std::mutex> lock(dependency->m_mutex);
+    if (!dependency->isDone()) {
+      job->m_pendingDependencies.fetch_add(1, std::memory_order_relaxed);
+      dependency->m_continuations.push_back(job);
+    }
+  }
+  if (job->m_pendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    schedule(job);
+  }
+  return job;
+}
+
+void JobSystem::schedule(JobHandle job) {
+  // Продолжения кладём в очередь текущего воркера, внешние задачи раскидываем по кругу
+  size_t workerIdx = currentWorkerIdx;
+  if (workerIdx == NOT_A_WORKER) {
+    workerIdx = m_nextWorker.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_workers[workerIdx]->mutex);
+    m_workers[workerIdx]->jobs.push_back(std::move(job));
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    m_queuedJobs.fetch_add(1, std::memory_order_relaxed);
+  }
+  m_sleepCondition.notify_one();
+}
+
+void JobSystem::execute(const JobHandle &job) {
+  ZoneScoped;
+  const bool isCancelled = job->isCancelled();
+  if (!isCancelled) {
+    job->m_func();
+  }
+  job->m_func = nullptr;
+
+  std::vector<JobHandle> continuations;
+  {
+    std::lock_guard<std::mutex> lock(job->m_mutex);
+    job->m_isDone.store(true, std::memory_order_release);
+    std::swap(continuations, job->m_continuations);
+  }
+  for (auto &continuation : continuations) {
+    if (isCancelled) {
+      continuation->cancel();
+    }
+    if (continuation->m_pendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      schedule(std::move(continuation));
+    }
+  }
+}
+
+JobHandle JobSystem::popLocal(size_t workerIdx) {
+  auto &worker = *m_workers[workerIdx];
+  std::lock_guard<std::mutex> lock(worker.mutex);
+  if (worker.jobs.empty()) {
+    return nullptr;
+  }
+  auto job = std::move(worker.jobs.back());
+  worker.jobs.pop_back();
+  return job;
+}
+
+JobHandle JobSystem::steal(size_t thiefIdx) {
+  for (size_t i = 1; i < m_workers.size(); i++) {
+    auto &victim = *m_workers[(thiefIdx + i) % m_workers.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.jobs.empty()) {
+      auto job = std::move(victim.jobs.front());
+      victim.jobs.pop_front();
+      return job;
+    }
+  }
+  return nullptr;
+}
+
+void JobSystem::workerLoop(size_t workerIdx) {
+  currentWorkerIdx = workerIdx;
+  while (true) {
+    auto job = popLocal(workerIdx);
+    if (!job) {
+      job = steal(workerIdx);
+    }
+    if (job) {
+      m_queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+      execute(job);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(m_sleepMutex);
+    m_sleepCondition.wait(lock, [this]() {
+      return !m_isRunning.load() || m_queuedJobs.load(std::memory_order_relaxed) > 0;
+    });
+    if (!m_isRunning.load()) {
+      return;
+    }
+  }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "NonCopyable.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+class Job : NonCopyable {
+  friend class JobSystem;
+
+public:
+  explicit Job(std::function<void()> func) : m_func{std::move(func)} {}
+
+  inline bool isDone() const noexcept { return m_isDone.load(std::memory_order_acquire); }
+  inline bool isCancelled() const noexcept { return m_isCancelled.load(std::memory_order_acquire); }
+  // Отменённая задача не выполняется, если ещё не началась; отмена передаётся зависимым задачам
+  inline void cancel() noexcept { m_isCancelled.store(true, std::memory_order_release); }
+
+private:
+  std::function<void()> m_func;
+  // Число незавершённых зависимостей плюс одна "защитная" единица на время submit
+  std::atomic_int m_pendingDependencies = 1;
+  std::atomic_bool m_isDone = false;
+  std::atomic_bool m_isCancelled = false;
+  std::mutex m_mutex;
+  std::vector<std::shared_ptr<Job>> m_continuations;
+};
+
+using JobHandle = std::shared_ptr<Job>;
+
+// Пул постоянных потоков с собственной очередью у каждого воркера и кражей задач у соседей.
+// Задача попадает в очередь только после завершения всех её зависимостей.
+class JobSystem : NonCopyable {
+public:
+  explicit JobSystem(int workersCount);
+  ~JobSystem();
+
+  JobHandle submit(std::function<void()> func, std::span<const JobHandle> dependencies = {});
+  inline JobHandle submit(std::function<void()> func, const JobHandle &dependency) {
+    return submit(std::move(func), std::span<const JobHandle>(&dependency, 1));
+  }
+
+  inline int getWorkersCount() const noexcept { return static_cast<int>(m_workers.size()); }
+  inline int getQueuedJobsCount() const noexcept { return m_queuedJobs.load(std::memory_order_relaxed); }
+
+private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<JobHandle> jobs;
+    std::thread thread;
+  };
+
+  void workerLoop(size_t workerIdx);
+  void schedule(JobHandle job);
+  void execute(const JobHandle &job);
+  JobHandle popLocal(size_t workerIdx);
+  JobHandle steal(size_t thiefIdx);
+
+private:
+  std::vector<std::unique_ptr<Worker>> m_workers;
+  std::atomic_bool m_isRunning = true;
+  std::atomic_int m_queuedJobs = 0;
+  std::atomic_size_t m_nextWorker = 0;
+  std::mutex m_sleepMutex;
+  std::condition_variable m_sleepCondition;
+};
@@ -4,6 +4,7 @@
 #include "glm/fwd.hpp"
 #include "imgui.h"
 #include "imgui_internal.h"
+#include <algorithm>
 #include <cstddef>
 #include <memory>
 #include <tracy/Tracy.hpp>
@@ -11,10 +12,28 @@
 #include <vulkan/vulkan_core.h>
 #include <vulkan/vulkan_structs.hpp>
 
+namespace {
+constexpr size_t BYTES_IN_MB = 1024 * 1024;
+// Загрузка мешей не должна съедать кадр, даже если после телепорта готовы сотни чанков
+constexpr ChunkUploadQueue::Budget MESH_UPLOAD_BUDGET = {.maxBytes = 8 * BYTES_IN_MB, .maxMilliseconds = 4.0f};
+// Отсечение идёт в кадре, поэтому обход пещер не должен занимать больше миллисекунды
+constexpr ChunksCuller::Budget CULLING_BUDGET = {.maxMilliseconds = 1.0f};
+// Страница арены мешей чанков: 48 MB вершин и 36 MB индексов (полтора индекса на вершину у граней-квадов)
+constexpr uint32_t CHUNK_ARENA_PAGE_VERTICES = 6 * 1024 * 1024;
+constexpr uint32_t CHUNK_ARENA_PAGE_INDICES = 9 * 1024 * 1024;
+// Сжатие арены ждёт простоя GPU, поэтому запускается, только когда раздроблены заметные объёмы,
+// не чаще раза в ARENA_COMPACTION_INTERVAL кадров и копирует не больше бюджета за раз
+constexpr float ARENA_COMPACTION_FRAGMENTATION = 0.5f;
+constexpr vk::DeviceSize ARENA_COMPACTION_MIN_BYTES = 16 * BYTES_IN_MB;
+constexpr vk::DeviceSize ARENA_COMPACTION_BUDGET = 4 * BYTES_IN_MB;
+constexpr uint32_t ARENA_COMPACTION_INTERVAL = 120;
+} // namespace
+
 Scene::Scene(RenderDeviceVk *device, Renderer *renderer, Keyboard *keyboard, Mouse *mouse, Window *window)
     : m_device{device}, m_keyboard{keyboard}, m_mouse{mouse}, m_renderer{renderer}, m_window{window},
-      m_textureAtlas{device, getTexturesPath().string()}, m_blocksManager{getBlocksPath().string(), m_textureAtlas},
-      m_playerController{{0, 5, 0}}, m_chunksManager{m_blocksManager, m_textureAtlas, m_playerController} {
+      m_config{ConfigLoader::load(getConfigPath())}, m_textureAtlas{device, getTexturesPath().string()},
+      m_blocksManager{getBlocksPath().string(), m_textureAtlas.getTexturesIndices()}, m_playerController{{0, 5, 0}},
+      m_chunksManager{m_blocksManager, m_playerController, m_config} {
   ZoneScoped;
   globalPool = DescriptorPoolVk::Builder(m_device)
                    .setMaxSets(SwapChainVk::MAX_FRAMES_IN_FLIGHT)
@@ -22,6 +41,9 @@ Scene::Scene(RenderDeviceVk *device, Renderer *renderer, Keyboard *keyboard, Mou
                    .addPoolSize(vk::DescriptorType::eCombinedImageSampler, SwapChainVk::MAX_FRAMES_IN_FLIGHT)
                    .build();
 
+  m_chunkMeshArena =
+      std::make_unique<MeshArena>(m_device, sizeof(ChunkVertex), CHUNK_ARENA_PAGE_VERTICES, CHUNK_ARENA_PAGE_INDICES);
+
   m_camera = std::make_unique<Camera>();
   m_camera->setPosition({0.0f, 128.0f, 0.0f});
 
@@ -51,10 +73,14 @@ Scene::Scene(RenderDeviceVk *device, Renderer *renderer, Keyboard *keyboard, Mou
         .build(m_globalDescriptorSets[i]);
   }
 
-  m_chunkRenderSystem = std::make_unique<ChunkRenderSystem>(m_device, m_renderer->getSwapChainRenderPass(),
-                                                            globalSetLayout->getDescriptorSetLayout());
-  m_skyboxRenderSystem = std::make_unique<SkyboxRenderSystem>(m_device, m_renderer->getSwapChainRenderPass(),
-                                                              globalSetLayout->getDescriptorSetLayout());
+  if (m_config.gpuCulling) {
+    m_chunkCullingSystem = std::make_unique<ChunkCullingSystem>(m_device);
+  }
+  m_chunkRenderSystem = std::make_unique<ChunkRenderSystem>(
+      m_device, m_renderer->getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout(), &m_renderQueue,
+      m_chunkMeshArena.get(), m_chunkCullingSystem.get());
+  m_skyboxRenderSystem = std::make_unique<SkyboxRenderSystem>(
+      m_device, m_renderer->getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout(), &m_renderQueue);
 }
 
 Scene::~Scene() {
@@ -100,6 +126,8 @@ void Scene::update(float dt) {
   if (glm::dot(movementDirection, movementDirection) > std::numeric_limits<float>::epsilon()) {
     m_playerController.move(dt * 2500.0f * glm::normalize(movementDirection));
   }
+  m_playerController.update(dt);
+  m_chunksManager.notifyPlayerMoved();
 
   if (m_playerController.getPosInChunk() != m_camera->getPosition()) {
     m_camera->setPosition(m_playerController.getPosInChunk());
@@ -109,12 +137,40 @@ void Scene::update(float dt) {
   if (yaw != 0.0f || pitch != 0.0f) {
     m_camera->rotate(yaw, pitch);
   }
-  m_chunksManager.forEachChunk([this](std::shared_ptr<Chunk> chunk) {
-    ZoneScopedN("Generate Mesh");
-    if (chunk && chunk->getMesh() == nullptr || chunk->isMeshOutdated()) {
-      chunk->generateMesh(m_device);
+  m_uploadStats = m_chunksManager.uploadMeshes(MESH_UPLOAD_BUDGET, [this](Chunk &chunk) {
+    const size_t bytes = chunk.generateMesh(m_chunkMeshArena.get());
+    if (m_chunkCullingSystem) {
+      m_chunkCullingSystem->updateChunk(chunk);
     }
+    return bytes;
   });
+  m_meshArenaStats = m_chunkMeshArena->getStats();
+  m_framesSinceCompaction++;
+  if (m_framesSinceCompaction >= ARENA_COMPACTION_INTERVAL &&
+      m_meshArenaStats.fragmentation > ARENA_COMPACTION_FRAGMENTATION &&
+      m_meshArenaStats.fragmentedBytes > ARENA_COMPACTION_MIN_BYTES) {
+    m_framesSinceCompaction = 0;
+    if (m_chunkMeshArena->compact(ARENA_COMPACTION_BUDGET) > 0 && m_chunkCullingSystem) {
+      m_chunkCullingSystem->updateAllChunks();
+    }
+  }
+}
+
+void Scene::preRender(vk::CommandBuffer commandBuffer) {
+  ZoneScoped;
+  if (!m_chunkCullingSystem) {
+    return;
+  }
+  m_chunkCullingSystem->syncChunks(m_chunksManager.getSnapshot());
+  const ChunkCullingSystem::View view = {
+      .frustum = m_camera->getFrustum(),
+      .projectionView = m_camera->getProjectionMatrix() * m_camera->getViewMatrix(),
+      .position = m_camera->getPosition(),
+      .front = m_camera->getFront(),
+      .playerX = m_playerController.getChunkX(),
+      .playerZ = m_playerController.getChunkZ(),
+  };
+  m_chunkCullingSystem->cull(commandBuffer, m_renderer->getFrameIndex(), view, m_renderer->getSwapChainExtent());
 }
 
 void Scene::render(vk::CommandBuffer commandBuffer) {
@@ -126,23 +182,44 @@ void Scene::render(vk::CommandBuffer commandBuffer) {
   m_ubo.dayTime = static_cast<float>(m_dayTime);
 
   auto frameIndex = m_renderer->getFrameIndex();
-  m_chunksManager.updateFrustum(m_camera->getFrustum());
+  m_chunksManager.updateView(m_camera->getFront());
+  const int playerX = m_playerController.getChunkX();
+  const int playerZ = m_playerController.getChunkZ();
+  // Видимость считается по камере этого кадра, а не по той, что видел поток менеджера
+  ChunksCuller::RenderList renderList;
+  if (const auto snapshot = m_chunksManager.getSnapshot(); snapshot && !m_chunkCullingSystem) {
+    renderList = m_chunksCuller.cull(*snapshot, m_camera->getFrustum(), m_camera->getPosition(), playerX, playerZ,
+                                     CULLING_BUDGET);
+  }
   FrameData frameData = {
       .commandBuffer = commandBuffer,
-      .chunks = m_chunksManager.getChunksToRender(),
-      .playerX = m_playerController.getChunkX(),
-      .playerZ = m_playerController.getChunkZ(),
+      .chunks = std::move(renderList.chunks),
+      .chunkVisibleSections = std::move(renderList.visibleSections),
+      .playerX = playerX,
+      .playerZ = playerZ,
+      .cameraPosition = m_camera->getPosition(),
       .globalDescriptorSet = m_globalDescriptorSets[frameIndex],
       .frameIndex = frameIndex,
   };
+  m_chunkDrawsCount = static_cast<size_t>(std::ranges::count_if(
+      frameData.chunks, [](const std::shared_ptr<Chunk> &chunk) { return chunk->getMesh() != nullptr; }));
   m_globalBuffers[frameIndex]->writeToBuffer(&m_ubo);
   m_globalBuffers[frameIndex]->flush();
   // frameData.gameObjects[0].model =
   //     glm::rotate(frameData.gameObjects[0].model, 0.00005f,
   //                 glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)));
 
-  m_skyboxRenderSystem->render(frameData);
-  m_chunkRenderSystem->render(frameData);
+  m_skyboxRenderSystem->submit(frameData);
+  m_chunkRenderSystem->submit(frameData);
+  m_renderQueue.execute(frameData);
+}
+
+void Scene::postRender(vk::CommandBuffer commandBuffer) {
+  ZoneScoped;
+  if (m_chunkCullingSystem) {
+    m_chunkCullingSystem->buildDepthPyramid(commandBuffer, m_renderer->getFrameIndex(),
+                                            m_renderer->getCurrentDepthImageView());
+  }
 }
 
 void Scene::renderUI() {
@@ -151,6 +228,8 @@ void Scene::renderUI() {
   ImGuiIO &io = g.IO;
   ImGui::Begin("Engine info");
   ImGui::Text("Average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
+  ImGui::Text("Render queue: %zu draws in %zu batches", m_renderQueue.getDrawsCount(),
+              m_renderQueue.getBatchesCount());
   ImGui::End();
 
   ImGui::Begin("Player");
@@ -160,4 +239,53 @@ void Scene::renderUI() {
               m_camera->getFront().z);
   ImGui::Text("Chunk: %d, %d", m_playerController.getChunkX(), m_playerController.getChunkZ());
   ImGui::End();
+
+  ImGui::Begin("World");
+  int loadRadius = m_chunksManager.getLoadRadius();
+  if (ImGui::SliderInt("Render distance", &loadRadius, ChunksManager::MIN_LOAD_RADIUS,
+                       ChunksManager::MAX_LOAD_RADIUS)) {
+    m_chunksManager.setLoadRadius(loadRadius);
+  }
+  int memoryBudgetMb = static_cast<int>(m_chunksManager.getMemoryBudget() / BYTES_IN_MB);
+  if (ImGui::InputInt("Memory budget (MB, 0 - unlimited)", &memoryBudgetMb, 64, 512)) {
+    m_chunksManager.setMemoryBudget(static_cast<size_t>(std::max(0, memoryBudgetMb)) * BYTES_IN_MB);
+  }
+  ImGui::Text("Effective render distance: %d", m_chunksManager.getEffectiveLoadRadius());
+  ImGui::Text("Chunks memory: %.1f MB", static_cast<float>(m_chunksManager.getMemoryUsage()) / BYTES_IN_MB);
+  if (m_chunkCullingSystem) {
+    ImGui::Text("GPU culling (no cave culling): %zu chunks in table, cached chunks: %zu",
+                m_chunkCullingSystem->getChunksCount(), m_chunksManager.getCachedChunksCount());
+    const auto &gpuStats = m_chunkCullingSystem->getStats();
+    const float occludedShare =
+        gpuStats.frustumTriangles > 0
+            ? 1.0f - static_cast<float>(gpuStats.drawnTriangles) / static_cast<float>(gpuStats.frustumTriangles)
+            : 0.0f;
+    ImGui::Text("Triangles drawn: %zu, hidden by occlusion: %.1f%%%s", gpuStats.drawnTriangles,
+                occludedShare * 100.0f, gpuStats.isOcclusionEnabled ? "" : " (off while camera moves)");
+  } else {
+    const auto &cullingStats = m_chunksCuller.getStats();
+    ImGui::Text("Holes on screen: %.1f%%, cached chunks: %zu", cullingStats.holesOnScreen * 100.0f,
+                m_chunksManager.getCachedChunksCount());
+    ImGui::Text("Frustum culling: %.1f us, chunk draws: %zu", cullingStats.microseconds, m_chunkDrawsCount);
+    ImGui::Text("Sections hidden by cave culling: %zu%s", cullingStats.caveCulledSections,
+                cullingStats.isSectionsWalkInterrupted ? " (walk over budget)" : "");
+  }
+  ImGui::Text("Mesh arena: %zu pages, %.1f of %.1f MB used, fragmentation: %.0f%%, moved meshes: %zu",
+              m_meshArenaStats.pagesCount, static_cast<float>(m_meshArenaStats.usedBytes) / BYTES_IN_MB,
+              static_cast<float>(m_meshArenaStats.capacityBytes) / BYTES_IN_MB,
+              m_meshArenaStats.fragmentation * 100.0f, m_meshArenaStats.movedMeshes);
+  ImGui::Text("Mesh uploads: %zu chunks, %.2f MB this frame, %zu pending", m_uploadStats.uploadedChunks,
+              static_cast<float>(m_uploadStats.uploadedBytes) / BYTES_IN_MB, m_uploadStats.pendingChunks);
+  const auto pipelineStats = m_chunksManager.getPipelineStats();
+  ImGui::Text("Generating: %zu (slots: %d)", pipelineStats.generating, pipelineStats.generationSlots);
+  ImGui::Text("Mesh queue: %zu (+%zu waiting for neighbors), meshing: %zu (slots: %d)", pipelineStats.meshQueueDepth,
+              pipelineStats.meshDeferred, pipelineStats.meshing, pipelineStats.meshingSlots);
+  ImGui::Text("Upload queue: %zu", pipelineStats.uploadQueueDepth);
+  if (ImGui::CollapsingHeader("Chunk states")) {
+    for (size_t i = 0; i < CHUNK_STATES_COUNT; i++) {
+      const auto state = static_cast<ChunkState>(i);
+      ImGui::Text("%s: %d", toString(state), Chunk::getStateCount(state));
+    }
+  }
+  ImGui::End();
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../assets/ConfigLoader.hpp"
 #include "../input/Keyboard.hpp"
 #include "../input/Mouse.hpp"
 #include "../renderSystems/ChunkRenderSystem.hpp"
@@ -28,7 +29,11 @@ public:
   ~Scene();
 
   void update(float dt);
+  // Работа кадра вне рендер-пасса, до render
+  void preRender(vk::CommandBuffer commandBuffer);
   void render(vk::CommandBuffer commandBuffer);
+  // Работа кадра вне рендер-пасса, после render
+  void postRender(vk::CommandBuffer commandBuffer);
   void renderUI();
 
 private:
@@ -36,7 +41,13 @@ private:
   Keyboard *m_keyboard;
   Mouse *m_mouse;
   Window *m_window;
+  // Меши всех чанков; объявлена раньше всего, что держит меши, чтобы разрушаться последней
+  std::unique_ptr<MeshArena> m_chunkMeshArena;
   std::unique_ptr<DescriptorPoolVk> globalPool{};
+  // Отрисовки всех систем рендера, сортируются по ключам каждый кадр
+  RenderQueue m_renderQueue;
+  // nullptr, если отсечение идёт на CPU; система рендера читает его буферы и разрушается раньше
+  std::unique_ptr<ChunkCullingSystem> m_chunkCullingSystem;
   std::unique_ptr<ChunkRenderSystem> m_chunkRenderSystem;
   std::unique_ptr<SkyboxRenderSystem> m_skyboxRenderSystem;
   std::unique_ptr<Camera> m_camera;
@@ -45,9 +56,16 @@ private:
   std::vector<vk::DescriptorSet> m_globalDescriptorSets;
   std::vector<std::unique_ptr<BufferVk>> m_globalBuffers;
   GlobalUBO m_ubo;
+  Config m_config;
   TextureAtlas m_textureAtlas;
   BlocksManager m_blocksManager;
   ChunksManager m_chunksManager;
+  // Отсечение по камере кадра в потоке рендера
+  ChunksCuller m_chunksCuller;
   FrameData m_prevFrameData;
+  ChunkUploadQueue::Stats m_uploadStats = {};
+  MeshArena::Stats m_meshArenaStats = {};
+  uint32_t m_framesSinceCompaction = 0;
+  size_t m_chunkDrawsCount = 0;
   int m_dayTime = 9995;
 };
\ No newline at end of file
@@ -0,0 +1,294 @@
+#include "StreamingBenchmark.hpp"
+#include "../assets/ConfigLoader.hpp"
+#include "../assets/Utils.hpp"
+#include "../world/BlocksManager.hpp"
+#include "../world/ChunksCuller.hpp"
+#include "../world/ChunksManager.hpp"
+#include "../world/PlayerController.hpp"
+#include "../world/TextureAtlas.hpp"
+#include "Camera.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <thread>
+#include <tracy/Tracy.hpp>
+
+namespace {
+constexpr size_t BYTES_IN_MB = 1024 * 1024;
+// Тот же бюджет, что у Scene, чтобы очередь загрузки вела себя как в игре
+constexpr ChunkUploadQueue::Budget MESH_UPLOAD_BUDGET = {.maxBytes = 8 * BYTES_IN_MB, .maxMilliseconds = 4.0f};
+constexpr ChunksCuller::Budget CULLING_BUDGET = {.maxMilliseconds = 1.0f};
+// Камера как в Scene, но над рельефом и с наклоном вниз: в кадр попадает и земля, и горизонт
+constexpr float CAMERA_FOV = 75.0f;
+constexpr float CAMERA_ASPECT_RATIO = 16.0f / 9.0f;
+constexpr float CAMERA_FAR_PLANE = 2000.0f;
+constexpr float CAMERA_HEIGHT = 100.0f;
+constexpr float CAMERA_PITCH = -15.0f;
+
+float toMilliseconds(std::chrono::steady_clock::duration duration) {
+  return std::max(0.0f, std::chrono::duration<float, std::milli>(duration).count());
+}
+} // namespace
+
+std::optional<StreamingBenchmark::Path> StreamingBenchmark::parsePath(std::string_view name) noexcept {
+  if (name == "straight") {
+    return Path::Straight;
+  }
+  if (name == "spiral") {
+    return Path::Spiral;
+  }
+  if (name == "teleport") {
+    return Path::Teleport;
+  }
+  return std::nullopt;
+}
+
+std::string_view StreamingBenchmark::toString(Path path) noexcept {
+  switch (path) {
+  case Path::Straight:
+    return "straight";
+  case Path::Spiral:
+    return "spiral";
+  case Path::Teleport:
+    return "teleport";
+  }
+  return "unknown";
+}
+
+nlohmann::json StreamingBenchmark::run() {
+  ZoneScoped;
+  const Config config = ConfigLoader::load(getConfigPath());
+  BlocksManager blocksManager(getBlocksPath().string(), TextureAtlas::loadTexturesIndices(getTexturesPath().string()));
+  PlayerController playerController({0, 5, 0});
+  ChunksManager chunksManager(blocksManager, playerController, config,
+                              [this](int x, int z, ChunkState state) { onStage(x, z, state); });
+
+  // Заглушка вместо загрузки на GPU: те же переходы состояний, но без Vulkan
+  auto upload = [this](Chunk &chunk) {
+    const size_t bytes = chunk.generateMesh(nullptr);
+    if (chunk.getState() == ChunkState::Resident) {
+      onStage(chunk.x(), chunk.z(), ChunkState::Resident);
+    }
+    return bytes;
+  };
+  const auto frameDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(FRAME_TIME));
+  glm::vec2 position(0.0f);
+  glm::vec3 viewDirection(1.0f, 0.0f, 0.0f);
+  Camera camera;
+  camera.setProjection(CAMERA_FOV, CAMERA_ASPECT_RATIO, 0.1f, CAMERA_FAR_PLANE);
+  ChunksCuller chunksCuller;
+  // Доля видимых камерой позиций сетки без меша за каждый кадр замера, в процентах
+  std::vector<float> holesPercents;
+  // Один кадр игры: движение игрока, события менеджеру, загрузка готовых мешей, отсечение по камере
+  auto runFrame = [&](std::optional<float> pathTime) {
+    const auto frameStart = Clock::now();
+    if (pathTime) {
+      const glm::vec2 nextPosition = getPathPosition(*pathTime, chunksManager.getLoadRadius());
+      const glm::vec2 displacement = nextPosition - position;
+      position = nextPosition;
+      playerController.move(glm::vec3(displacement.x, 0.0f, displacement.y));
+      const float length = glm::length(displacement);
+      if (length > 0.0f) {
+        viewDirection = glm::vec3(displacement.x, 0.0f, displacement.y) / length;
+      }
+    }
+    playerController.update(FRAME_TIME);
+    chunksManager.notifyPlayerMoved();
+    chunksManager.updateView(viewDirection);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      updateRegion({playerController.getChunkX(), playerController.getChunkZ(),
+                    chunksManager.getEffectiveLoadRadius()},
+                   frameStart);
+    }
+    chunksManager.uploadMeshes(MESH_UPLOAD_BUDGET, upload);
+    if (const auto snapshot = chunksManager.getSnapshot(); snapshot && pathTime) {
+      const glm::vec3 &positionInChunk = playerController.getPosInChunk();
+      camera.setPosition({positionInChunk.x, CAMERA_HEIGHT, positionInChunk.z});
+      camera.setOrientation(glm::degrees(std::atan2(viewDirection.z, viewDirection.x)), CAMERA_PITCH);
+      chunksCuller.cull(*snapshot, camera.getFrustum(), camera.getPosition(), playerController.getChunkX(),
+                        playerController.getChunkZ(), CULLING_BUDGET);
+      holesPercents.push_back(chunksCuller.getStats().holesOnScreen * 100.0f);
+    }
+    std::this_thread::sleep_until(frameStart + frameDuration);
+  };
+
+  const auto warmupStart = Clock::now();
+  while (true) {
+    runFrame(std::nullopt);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const size_t sideSize = static_cast<size_t>(m_region->radius * 2 + 1);
+    if (m_completedCount >= sideSize * sideSize ||
+        Clock::now() - warmupStart > std::chrono::duration<float>(MAX_WARMUP_SECONDS)) {
+      break;
+    }
+  }
+  const float warmupSeconds = std::chrono::duration<float>(Clock::now() - warmupStart).count();
+  {
+    // Чанки стартовой области уже готовы и больше не войдут в радиус, их записи не нужны
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_timings.clear();
+    m_enteredCount = 0;
+    m_completedCount = 0;
+    m_generatedCount = 0;
+    m_meshedCount = 0;
+    m_generatedLatencies.clear();
+    m_meshedLatencies.clear();
+    m_uploadedLatencies.clear();
+  }
+
+  const WorldGenerator::Stats warmupGeneration = chunksManager.getGenerationStats();
+  size_t framesCount = 0;
+  const auto start = Clock::now();
+  float elapsed = 0.0f;
+  while (elapsed < m_options.durationSeconds) {
+    runFrame(static_cast<float>(framesCount) * FRAME_TIME);
+    framesCount++;
+    elapsed = std::chrono::duration<float>(Clock::now() - start).count();
+  }
+
+  // Доля руд - от суммарного времени генерации на всех потоках за замер
+  const WorldGenerator::Stats generation = chunksManager.getGenerationStats();
+  const float generationMs = toMilliseconds(generation.generationTime - warmupGeneration.generationTime);
+  const float oresMs = toMilliseconds(generation.oresTime - warmupGeneration.oresTime);
+  float holesSum = 0.0f;
+  for (const float holes : holesPercents) {
+    holesSum += holes;
+  }
+  const float holesMean = holesPercents.empty() ? 0.0f : holesSum / static_cast<float>(holesPercents.size());
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return {
+      {"path", toString(m_options.path)},
+      {"duration_s", elapsed},
+      {"frames", framesCount},
+      {"speed", m_options.speed},
+      {"load_radius", chunksManager.getLoadRadius()},
+      {"effective_load_radius", chunksManager.getEffectiveLoadRadius()},
+      {"hardware_threads", std::thread::hardware_concurrency()},
+      {"warmup_s", warmupSeconds},
+      {"chunks",
+       {{"entered", m_enteredCount},
+        {"completed", m_completedCount},
+        {"generated", m_generatedCount},
+        {"meshed", m_meshedCount}}},
+      {"latency_ms",
+       {{"generated", getPercentiles(m_generatedLatencies)},
+        {"meshed", getPercentiles(m_meshedLatencies)},
+        {"uploaded", getPercentiles(m_uploadedLatencies)}}},
+      {"throughput_per_s",
+       {{"completed", static_cast<float>(m_completedCount) / elapsed},
+        {"generated", static_cast<float>(m_generatedCount) / elapsed},
+        {"meshed", static_cast<float>(m_meshedCount) / elapsed}}},
+      {"holes_on_screen_percent", {{"mean", holesMean}, {"per_frame", getPercentiles(holesPercents)}}},
+      {"generation_ms",
+       {{"total", generationMs}, {"ores", oresMs}, {"ores_share", generationMs > 0.0f ? oresMs / generationMs : 0.0f}}},
+      {"meshes_per_generated_chunk",
+       m_generatedCount > 0 ? static_cast<float>(m_meshedCount) / static_cast<float>(m_generatedCount) : 0.0f},
+  };
+}
+
+glm::vec2 StreamingBenchmark::getPathPosition(float time, int loadRadius) const {
+  const float distance = m_options.speed * time;
+  switch (m_options.path) {
+  case Path::Straight:
+    return {distance, 0.0f};
+  case Path::Spiral: {
+    // Архимедова спираль r = a * angle, длина дуги ~ a * angle^2 / 2
+    constexpr float a = SPIRAL_STEP / (2.0f * std::numbers::pi_v<float>);
+    const float angle = std::sqrt(2.0f * distance / a);
+    return glm::vec2(std::cos(angle), std::sin(angle)) * (a * angle);
+  }
+  case Path::Teleport: {
+    // Прыжок дальше радиуса загрузки и кольца удержания: ни один загруженный чанк не пригодится
+    const float jump = static_cast<float>((loadRadius + ChunksManager::MAX_LOAD_RADIUS) * Chunk::CHUNK_SIZE);
+    return {std::floor(time / TELEPORT_INTERVAL_SECONDS) * jump, 0.0f};
+  }
+  }
+  return {0.0f, 0.0f};
+}
+
+void StreamingBenchmark::onStage(int x, int z, ChunkState state) {
+  const auto now = Clock::now();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto &timings = m_timings[getChunkKey(x, z)];
+  // До входа в радиус храним последнее событие: предзагруженный чанк могли выгрузить и сгенерировать заново.
+  // После входа - первое, повторные мешинги из-за соседей не считаются задержкой.
+  auto record = [&](std::optional<Clock::time_point> &time) {
+    if (!timings.enteredAt || !time) {
+      time = now;
+    }
+  };
+  switch (state) {
+  case ChunkState::Generated:
+    m_generatedCount++;
+    record(timings.generatedAt);
+    break;
+  case ChunkState::MeshReady:
+    m_meshedCount++;
+    record(timings.meshedAt);
+    break;
+  case ChunkState::Resident:
+    record(timings.uploadedAt);
+    break;
+  default:
+    return;
+  }
+  tryReport(timings);
+}
+
+void StreamingBenchmark::updateRegion(const Region &region, Clock::time_point now) {
+  if (m_region && m_region->x == region.x && m_region->z == region.z && m_region->radius == region.radius) {
+    return;
+  }
+  // Покинувшие радиус чанки забываем: если они вернутся из кэша удержания, это уже не подгрузка
+  if (m_region) {
+    for (int z = m_region->z - m_region->radius; z <= m_region->z + m_region->radius; z++) {
+      for (int x = m_region->x - m_region->radius; x <= m_region->x + m_region->radius; x++) {
+        if (!region.contains(x, z)) {
+          m_timings.erase(getChunkKey(x, z));
+        }
+      }
+    }
+  }
+  for (int z = region.z - region.radius; z <= region.z + region.radius; z++) {
+    for (int x = region.x - region.radius; x <= region.x + region.radius; x++) {
+      if (m_region && m_region->contains(x, z)) {
+        continue;
+      }
+      auto &timings = m_timings[getChunkKey(x, z)];
+      timings.enteredAt = now;
+      m_enteredCount++;
+      tryReport(timings);
+    }
+  }
+  m_region = region;
+}
+
+void StreamingBenchmark::tryReport(ChunkTimings &timings) {
+  if (timings.isReported || !timings.enteredAt || !timings.generatedAt || !timings.meshedAt ||
+      !timings.uploadedAt) {
+    return;
+  }
+  timings.isReported = true;
+  m_completedCount++;
+  // Чанк, готовый до входа в радиус (предзагрузка), даёт нулевую задержку
+  m_generatedLatencies.push_back(toMilliseconds(*timings.generatedAt - *timings.enteredAt));
+  m_meshedLatencies.push_back(toMilliseconds(*timings.meshedAt - *timings.enteredAt));
+  m_uploadedLatencies.push_back(toMilliseconds(*timings.uploadedAt - *timings.enteredAt));
+}
+
+nlohmann::json StreamingBenchmark::getPercentiles(std::vector<float> &values) {
+  if (values.empty()) {
+    return {{"count", 0}, {"p50", nullptr}, {"p95", nullptr}, {"p99", nullptr}, {"max", nullptr}};
+  }
+  std::sort(values.begin(), values.end());
+  auto percentile = [&](float p) {
+    const size_t rank = static_cast<size_t>(std::ceil(p * static_cast<float>(values.size())));
+    return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+  };
+  return {{"count", values.size()},
+          {"p50", percentile(0.50f)},
+          {"p95", percentile(0.95f)},
+          {"p99", percentile(0.99f)},
+          {"max", values.back()}};
+}
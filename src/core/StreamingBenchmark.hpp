@@ -0,0 +1,91 @@
+#pragma once
+
+#include "../world/ChunkState.hpp"
+#include "NonCopyable.hpp"
+#include <chrono>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Прогон настоящего конвейера ChunksManager без окна и Vulkan: игрок движется по заданному маршруту,
+// загрузка мешей на GPU заменена заглушкой. Для каждого чанка, вошедшего в радиус загрузки,
+// замеряется время до Generated, MeshReady и окончания загрузки. Результат - JSON для сравнения коммитов.
+class StreamingBenchmark : NonCopyable {
+public:
+  enum class Path { Straight, Spiral, Teleport };
+
+  struct Options {
+    Path path = Path::Straight;
+    float durationSeconds = 30.0f;
+    // Скорость игрока в блоках в секунду
+    float speed = 40.0f;
+  };
+
+  explicit StreamingBenchmark(const Options &options) : m_options{options} {}
+
+  nlohmann::json run();
+
+  static std::optional<Path> parsePath(std::string_view name) noexcept;
+  static std::string_view toString(Path path) noexcept;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct ChunkTimings {
+    std::optional<Clock::time_point> enteredAt;
+    std::optional<Clock::time_point> generatedAt;
+    std::optional<Clock::time_point> meshedAt;
+    std::optional<Clock::time_point> uploadedAt;
+    bool isReported = false;
+  };
+
+  struct Region {
+    int x;
+    int z;
+    int radius;
+
+    inline bool contains(int chunkX, int chunkZ) const noexcept {
+      return chunkX >= x - radius && chunkX <= x + radius && chunkZ >= z - radius && chunkZ <= z + radius;
+    }
+  };
+
+  // Позиция игрока в блоках относительно старта через time секунд
+  glm::vec2 getPathPosition(float time, int loadRadius) const;
+  void onStage(int x, int z, ChunkState state);
+  // Вызывающий должен держать m_mutex
+  void updateRegion(const Region &region, Clock::time_point now);
+  // Вызывающий должен держать m_mutex
+  void tryReport(ChunkTimings &timings);
+  static nlohmann::json getPercentiles(std::vector<float> &values);
+
+  inline static uint64_t getChunkKey(int x, int z) noexcept {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(z);
+  }
+
+private:
+  static constexpr float FRAME_TIME = 1.0f / 60.0f;
+  // Прогрев - заполнение радиуса вокруг старта, в замеры не входит
+  static constexpr float MAX_WARMUP_SECONDS = 120.0f;
+  // Витки спирали расходятся на столько блоков
+  static constexpr float SPIRAL_STEP = 64.0f;
+  static constexpr float TELEPORT_INTERVAL_SECONDS = 5.0f;
+
+  const Options m_options;
+
+  std::mutex m_mutex;
+  std::unordered_map<uint64_t, ChunkTimings> m_timings;
+  std::optional<Region> m_region;
+  size_t m_enteredCount = 0;
+  size_t m_completedCount = 0;
+  size_t m_generatedCount = 0;
+  size_t m_meshedCount = 0;
+  // Задержки в миллисекундах от входа в радиус
+  std::vector<float> m_generatedLatencies;
+  std::vector<float> m_meshedLatencies;
+  std::vector<float> m_uploadedLatencies;
+};
@@ -1,11 +1,54 @@
 #include "core/App.hpp"
+#include "core/StreamingBenchmark.hpp"
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <string_view>
 #include <tracy/Tracy.hpp>
 
-int main() {
+namespace {
+// VulkanMine --benchmark <straight|spiral|teleport> [--duration <s>] [--speed <blocks/s>] [--output <file.json>]
+int runBenchmark(int argc, char **argv) {
+  StreamingBenchmark::Options options;
+  std::string_view outputPath;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const std::string_view arg = argv[i];
+    const std::string_view value = argv[i + 1];
+    if (arg == "--benchmark") {
+      const auto path = StreamingBenchmark::parsePath(value);
+      if (!path) {
+        std::cerr << "Unknown benchmark path: " << value << std::endl;
+        return EXIT_FAILURE;
+      }
+      options.path = *path;
+    } else if (arg == "--duration") {
+      options.durationSeconds = std::stof(std::string(value));
+    } else if (arg == "--speed") {
+      options.speed = std::stof(std::string(value));
+    } else if (arg == "--output") {
+      outputPath = value;
+    } else {
+      std::cerr << "Unknown argument: " << arg << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  const auto result = StreamingBenchmark{options}.run().dump(2);
+  if (outputPath.empty()) {
+    std::cout << result << std::endl;
+  } else {
+    std::ofstream(std::string(outputPath)) << result << std::endl;
+  }
+  return EXIT_SUCCESS;
+}
+} // namespace
+
+int main(int argc, char **argv) {
   ZoneScoped;
   try {
+    if (argc > 1 && std::string_view(argv[1]) == "--benchmark") {
+      return runBenchmark(argc, argv);
+    }
     App{}.run();
   } catch (const std::exception &e) {
     std::cerr << e.what() << std::endl;
@@ -13,4 +56,4 @@ int main() {
   }
 
   return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,418 @@
+#include "ChunkCullingSystem.hpp"
+#include <algorithm>
+#include <cassert>
+#include <tracy/Tracy.hpp>
+
+namespace {
+uint64_t getTileKey(const ChunksTile &tile) noexcept {
+  const int tileX = ChunksTile::toTilePos(tile.minX);
+  const int tileZ = ChunksTile::toTilePos(tile.minZ);
+  return (static_cast<uint64_t>(static_cast<uint32_t>(tileX)) << 32) | static_cast<uint32_t>(tileZ);
+}
+} // namespace
+
+ChunkCullingSystem::ChunkCullingSystem(RenderDeviceVk *device) : m_device{device} {
+  ZoneScoped;
+  m_slots.resize(MAX_SLOTS);
+  m_slotsData.resize(MAX_SLOTS);
+  m_slotDirtyFrames.resize(MAX_SLOTS, 0);
+  m_isSlotUploading.resize(MAX_SLOTS, 0);
+  createBuffers();
+  m_depthPyramid = std::make_unique<DepthPyramid>(m_device);
+  createDescriptorSets();
+  createPipelineLayout();
+  m_pipeline = std::make_unique<ComputePipelineVk>(m_device, "chunk_cull", m_pipelineLayout);
+}
+
+ChunkCullingSystem::~ChunkCullingSystem() {
+  ZoneScoped;
+  m_device->getDevice().destroyPipelineLayout(m_pipelineLayout);
+}
+
+void ChunkCullingSystem::syncChunks(const std::shared_ptr<const ChunksSnapshot> &snapshot) {
+  ZoneScoped;
+  if (!snapshot || snapshot == m_snapshot) {
+    return;
+  }
+  // Неизменный тайл переходит в новый срез тем же объектом, его чанки уже в таблице
+  m_nextTiles.clear();
+  m_changedTiles.clear();
+  for (const auto &tile : snapshot->tiles) {
+    const uint64_t key = getTileKey(*tile);
+    m_nextTiles.emplace(key, tile);
+    if (auto it = m_tiles.find(key); it != m_tiles.end() && it->second == tile) {
+      m_tiles.erase(it);
+      continue;
+    }
+    m_changedTiles.push_back(tile.get());
+  }
+  // Остались прежние версии сменившихся тайлов и тайлы, вышедшие из радиуса. Их слоты освобождаются первыми:
+  // при наибольшем радиусе занятых и новых чанков вместе больше, чем MAX_SLOTS
+  for (const auto &[key, tile] : m_tiles) {
+    for (const auto &chunk : tile->chunks) {
+      if (!chunk) {
+        continue;
+      }
+      if (!snapshot->isInLoadRadius(chunk->x(), chunk->z()) || snapshot->getChunk(chunk->x(), chunk->z()) != chunk) {
+        releaseSlot(chunk.get());
+      }
+    }
+  }
+  for (const ChunksTile *tile : m_changedTiles) {
+    for (const auto &chunk : tile->chunks) {
+      if (chunk) {
+        acquireSlot(chunk);
+      }
+    }
+  }
+  std::swap(m_tiles, m_nextTiles);
+  m_snapshot = snapshot;
+}
+
+void ChunkCullingSystem::updateChunk(const Chunk &chunk) {
+  ZoneScoped;
+  if (auto it = m_slotsByChunk.find(&chunk); it != m_slotsByChunk.end()) {
+    writeSlot(it->second);
+  }
+}
+
+void ChunkCullingSystem::updateAllChunks() {
+  ZoneScoped;
+  for (const auto &[chunk, slotIdx] : m_slotsByChunk) {
+    writeSlot(slotIdx);
+  }
+}
+
+void ChunkCullingSystem::cull(vk::CommandBuffer commandBuffer, size_t frameIndex, const View &view,
+                              vk::Extent2D depthExtent) {
+  ZoneScoped;
+  // Буферы этого кадра уже свободны: меши, вытесненные MAX_FRAMES_IN_FLIGHT кадров назад, больше никто не читает
+  m_frame++;
+  while (!m_retiredMeshes.empty() && m_retiredMeshes.front().first + SwapChainVk::MAX_FRAMES_IN_FLIGHT <= m_frame) {
+    m_retiredMeshes.pop_front();
+  }
+  // Загрузки, захваченные графикой в начале кадра, уже можно рисовать; writeSlot готового меша
+  // в список не добавляет
+  std::erase_if(m_uploadingSlots, [this](uint32_t slotIdx) {
+    const auto &chunk = m_slots[slotIdx].chunk;
+    const auto mesh = chunk ? chunk->getMesh() : nullptr;
+    if (mesh && !mesh->isReady()) {
+      return false;
+    }
+    m_isSlotUploading[slotIdx] = 0;
+    writeSlot(slotIdx);
+    return true;
+  });
+  auto &dirtySlots = m_dirtySlots[frameIndex];
+  for (const uint32_t slotIdx : dirtySlots) {
+    m_slotsBuffers[frameIndex]->writeToIndex(&m_slotsData[slotIdx], slotIdx);
+    m_drawsBuffers[frameIndex]->writeToIndex(&m_slotsData[slotIdx].position, slotIdx);
+    m_slotDirtyFrames[slotIdx] &= static_cast<uint8_t>(~(1u << frameIndex));
+  }
+  dirtySlots.clear();
+
+  // Пирамида прошлого размера не совпадает с экраном: до первой новой отсекаем только по пирамиде видимости
+  if (m_depthPyramid->resize(depthExtent)) {
+    writeDepthPyramidDescriptors();
+    m_pyramidView.reset();
+  }
+  // Счётчики кадра с этим индексом уже записаны: его забор дождались перед началом кадра
+  GpuStats stats = {};
+  m_statsBuffers[frameIndex]->readFromBuffer(&stats);
+  m_stats.frustumTriangles = stats.frustumIndices / 3;
+  m_stats.drawnTriangles = stats.drawnIndices / 3;
+  stats = {};
+  m_statsBuffers[frameIndex]->writeToBuffer(&stats);
+
+  m_frameView = view;
+  OcclusionData occlusion = {.isEnabled = 0};
+  m_stats.isOcclusionEnabled = m_pyramidView && isOcclusionReliable(view);
+  if (m_stats.isOcclusionEnabled) {
+    const vk::Extent2D pyramidExtent = m_depthPyramid->getDepthExtent();
+    occlusion = {
+        .projectionView = m_pyramidView->projectionView,
+        .viewChunk = {m_pyramidView->playerX, m_pyramidView->playerZ},
+        .depthSize = {static_cast<float>(pyramidExtent.width), static_cast<float>(pyramidExtent.height)},
+        .mipLevels = static_cast<int32_t>(m_depthPyramid->getMipLevels()),
+        .isEnabled = 1,
+    };
+  }
+  m_occlusionBuffers[frameIndex]->writeToBuffer(&occlusion);
+  reservePages(frameIndex);
+  updateDrawPages(frameIndex);
+  if (m_drawPages.empty()) {
+    return;
+  }
+
+  // Шейдер занимает место в командах страницы атомиками по её счётчику
+  commandBuffer.fillBuffer(m_countsBuffers[frameIndex]->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+  vk::MemoryBarrier clearBarrier = {
+      .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+      .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+  };
+  commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, 1,
+                                &clearBarrier, 0, nullptr, 0, nullptr);
+
+  PushConstantData push = {
+      .playerChunk = {view.playerX, view.playerZ},
+      .slotsCount = m_slotsCount,
+  };
+  std::copy_n(view.frustum.getPlanes(), push.frustumPlanes.size(), push.frustumPlanes.begin());
+  m_pipeline->bind(commandBuffer);
+  commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout, 0, 1,
+                                   &m_descriptorSets[frameIndex], 0, nullptr);
+  commandBuffer.pushConstants(m_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstantData),
+                              &push);
+  commandBuffer.dispatch((m_slotsCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+  // Счётчики читаются на CPU через MAX_FRAMES_IN_FLIGHT кадров
+  vk::MemoryBarrier barrier = {
+      .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+      .dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eHostRead,
+  };
+  commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eHost, {}, 1,
+                                &barrier, 0, nullptr, 0, nullptr);
+}
+
+void ChunkCullingSystem::buildDepthPyramid(vk::CommandBuffer commandBuffer, size_t frameIndex,
+                                           vk::ImageView depthView) {
+  ZoneScoped;
+  m_depthPyramid->build(commandBuffer, frameIndex, depthView);
+  m_pyramidView = m_frameView;
+}
+
+void ChunkCullingSystem::updateDrawPages(size_t frameIndex) {
+  ZoneScoped;
+  m_drawPages.clear();
+  m_pageFirstCommands.resize(m_pageSlotsCounts.size());
+  uint32_t firstCommand = 0;
+  for (uint32_t page = 0; page < m_pageSlotsCounts.size(); page++) {
+    m_pageFirstCommands[page] = firstCommand;
+    if (m_pageSlotsCounts[page] == 0) {
+      continue;
+    }
+    const uint32_t maxCommands = m_pageSlotsCounts[page] * MAX_SLOT_COMMANDS;
+    m_drawPages.push_back({.page = page, .firstCommand = firstCommand, .maxCommands = maxCommands});
+    firstCommand += maxCommands;
+  }
+  if (!m_pageFirstCommands.empty()) {
+    m_pagesBuffers[frameIndex]->writeToBuffer(m_pageFirstCommands.data(),
+                                              m_pageFirstCommands.size() * sizeof(uint32_t));
+  }
+}
+
+void ChunkCullingSystem::reservePages(size_t frameIndex) {
+  const uint32_t pagesCount = static_cast<uint32_t>(m_pageSlotsCounts.size());
+  if (pagesCount <= m_pagesCapacities[frameIndex]) {
+    return;
+  }
+  ZoneScoped;
+  // Забор кадра с этим индексом уже пройден: старые буферы и набор дескрипторов GPU больше не читает
+  const uint32_t capacity = std::max({pagesCount, m_pagesCapacities[frameIndex] * 2, MIN_PAGES_CAPACITY});
+  m_countsBuffers[frameIndex] =
+      std::make_unique<BufferVk>(m_device, sizeof(uint32_t), capacity,
+                                 vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer |
+                                     vk::BufferUsageFlagBits::eTransferDst,
+                                 VMA_MEMORY_USAGE_AUTO);
+  m_pagesBuffers[frameIndex] =
+      std::make_unique<BufferVk>(m_device, sizeof(uint32_t), capacity, vk::BufferUsageFlagBits::eStorageBuffer,
+                                 VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+  m_pagesCapacities[frameIndex] = capacity;
+  auto countsInfo = m_countsBuffers[frameIndex]->descriptorInfo();
+  auto pagesInfo = m_pagesBuffers[frameIndex]->descriptorInfo();
+  DescriptorWriterVk(*m_descriptorSetLayout, *m_descriptorPool)
+      .writeBuffer(2, &countsInfo)
+      .writeBuffer(6, &pagesInfo)
+      .overwrite(m_descriptorSets[frameIndex]);
+}
+
+bool ChunkCullingSystem::isOcclusionReliable(const View &view) const noexcept {
+  // Позиции камер отсчитаны от разных чанков
+  const glm::vec3 chunkShift(static_cast<float>((view.playerX - m_pyramidView->playerX) * Chunk::CHUNK_SIZE), 0.0f,
+                             static_cast<float>((view.playerZ - m_pyramidView->playerZ) * Chunk::CHUNK_SIZE));
+  const glm::vec3 shift = view.position + chunkShift - m_pyramidView->position;
+  return glm::dot(shift, shift) <= MAX_OCCLUSION_SHIFT * MAX_OCCLUSION_SHIFT &&
+         glm::dot(view.front, m_pyramidView->front) >= MIN_OCCLUSION_FRONT_COS;
+}
+
+void ChunkCullingSystem::acquireSlot(const std::shared_ptr<Chunk> &chunk) {
+  if (m_slotsByChunk.contains(chunk.get())) {
+    return;
+  }
+  uint32_t slotIdx;
+  if (!m_freeSlots.empty()) {
+    slotIdx = m_freeSlots.back();
+    m_freeSlots.pop_back();
+  } else if (m_slotsCount < MAX_SLOTS) {
+    slotIdx = m_slotsCount++;
+  } else {
+    // Срез не шире квадрата MAX_LOAD_RADIUS, а слоты ушедших чанков освобождаются раньше
+    assert(false && "Chunk culling slots exhausted");
+    return;
+  }
+  m_slotsByChunk.emplace(chunk.get(), slotIdx);
+  m_slots[slotIdx].chunk = chunk;
+  writeSlot(slotIdx);
+}
+
+void ChunkCullingSystem::releaseSlot(const Chunk *chunk) {
+  auto it = m_slotsByChunk.find(chunk);
+  if (it == m_slotsByChunk.end()) {
+    return;
+  }
+  const uint32_t slotIdx = it->second;
+  m_slotsByChunk.erase(it);
+  m_slots[slotIdx].chunk.reset();
+  writeSlot(slotIdx);
+  m_freeSlots.push_back(slotIdx);
+}
+
+void ChunkCullingSystem::writeSlot(uint32_t slotIdx) {
+  Slot &slot = m_slots[slotIdx];
+  GpuChunkSlot &data = m_slotsData[slotIdx];
+  // Страница из данных слота: compact мог уже перенести его меш
+  if (slot.mesh) {
+    m_pageSlotsCounts[data.page]--;
+  }
+  // Пустой слот даёт ноль команд
+  data = {};
+  auto mesh = slot.chunk ? slot.chunk->getMesh() : nullptr;
+  const auto sections = slot.chunk ? slot.chunk->getMeshSections() : nullptr;
+  const MeshArena::Range *range = mesh ? mesh->getArenaRange() : nullptr;
+  if (mesh && !mesh->isReady() && !m_isSlotUploading[slotIdx]) {
+    m_isSlotUploading[slotIdx] = 1;
+    m_uploadingSlots.push_back(slotIdx);
+  }
+  if (range && sections && mesh->isReady()) {
+    const VerticalBounds bounds = slot.chunk->getMeshBounds();
+    data.position = {slot.chunk->x(), slot.chunk->z()};
+    data.minY = static_cast<uint32_t>(bounds.minY);
+    data.maxY = static_cast<uint32_t>(bounds.maxY);
+    data.indexOffsets = sections->indexOffsets;
+    data.firstIndex = mesh->getFirstIndex();
+    data.vertexOffset = mesh->getVertexOffset();
+    data.page = range->page;
+    if (data.page >= m_pageSlotsCounts.size()) {
+      m_pageSlotsCounts.resize(data.page + 1, 0);
+    }
+    m_pageSlotsCounts[data.page]++;
+  } else {
+    mesh = nullptr;
+  }
+  if (slot.mesh != mesh) {
+    retireMesh(std::move(slot.mesh));
+    slot.mesh = std::move(mesh);
+  }
+  for (size_t frame = 0; frame < SwapChainVk::MAX_FRAMES_IN_FLIGHT; frame++) {
+    if (!(m_slotDirtyFrames[slotIdx] & (1u << frame))) {
+      m_dirtySlots[frame].push_back(slotIdx);
+    }
+  }
+  m_slotDirtyFrames[slotIdx] = ALL_FRAMES_MASK;
+}
+
+void ChunkCullingSystem::retireMesh(std::shared_ptr<Mesh<ChunkVertex>> mesh) {
+  if (mesh) {
+    m_retiredMeshes.emplace_back(m_frame, std::move(mesh));
+  }
+}
+
+void ChunkCullingSystem::createBuffers() {
+  ZoneScoped;
+  for (size_t i = 0; i < SwapChainVk::MAX_FRAMES_IN_FLIGHT; i++) {
+    m_slotsBuffers[i] =
+        std::make_unique<BufferVk>(m_device, sizeof(GpuChunkSlot), MAX_SLOTS, vk::BufferUsageFlagBits::eStorageBuffer,
+                                   VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+    // Пустые слоты должны давать ноль команд с первого кадра
+    m_slotsBuffers[i]->writeToBuffer(m_slotsData.data());
+    m_drawsBuffers[i] =
+        std::make_unique<BufferVk>(m_device, sizeof(glm::ivec2), MAX_SLOTS, vk::BufferUsageFlagBits::eStorageBuffer,
+                                   VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+    m_commandsBuffers[i] = std::make_unique<BufferVk>(
+        m_device, sizeof(vk::DrawIndexedIndirectCommand), MAX_SLOTS * MAX_SLOT_COMMANDS,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer, VMA_MEMORY_USAGE_AUTO);
+    m_countsBuffers[i] =
+        std::make_unique<BufferVk>(m_device, sizeof(uint32_t), MIN_PAGES_CAPACITY,
+                                   vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer |
+                                       vk::BufferUsageFlagBits::eTransferDst,
+                                   VMA_MEMORY_USAGE_AUTO);
+    m_pagesBuffers[i] = std::make_unique<BufferVk>(
+        m_device, sizeof(uint32_t), MIN_PAGES_CAPACITY, vk::BufferUsageFlagBits::eStorageBuffer,
+        VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+    m_pagesCapacities[i] = MIN_PAGES_CAPACITY;
+    m_occlusionBuffers[i] =
+        std::make_unique<BufferVk>(m_device, sizeof(OcclusionData), 1, vk::BufferUsageFlagBits::eUniformBuffer,
+                                   VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+    m_statsBuffers[i] =
+        std::make_unique<BufferVk>(m_device, sizeof(GpuStats), 1, vk::BufferUsageFlagBits::eStorageBuffer,
+                                   VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+    GpuStats stats = {};
+    m_statsBuffers[i]->writeToBuffer(&stats);
+  }
+}
+
+void ChunkCullingSystem::createDescriptorSets() {
+  ZoneScoped;
+  m_descriptorPool = DescriptorPoolVk::Builder(m_device)
+                         .setMaxSets(SwapChainVk::MAX_FRAMES_IN_FLIGHT)
+                         .addPoolSize(vk::DescriptorType::eStorageBuffer, 5 * SwapChainVk::MAX_FRAMES_IN_FLIGHT)
+                         .addPoolSize(vk::DescriptorType::eCombinedImageSampler, SwapChainVk::MAX_FRAMES_IN_FLIGHT)
+                         .addPoolSize(vk::DescriptorType::eUniformBuffer, SwapChainVk::MAX_FRAMES_IN_FLIGHT)
+                         .build();
+  m_descriptorSetLayout = DescriptorSetLayoutVk::Builder(m_device)
+                              .addBinding(0, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
+                              .addBinding(1, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
+                              .addBinding(2, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
+                              .addBinding(3, vk::DescriptorType::eCombinedImageSampler,
+                                          vk::ShaderStageFlagBits::eCompute)
+                              .addBinding(4, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eCompute)
+                              .addBinding(5, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
+                              .addBinding(6, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
+                              .build();
+  for (size_t i = 0; i < SwapChainVk::MAX_FRAMES_IN_FLIGHT; i++) {
+    auto slotsInfo = m_slotsBuffers[i]->descriptorInfo();
+    auto commandsInfo = m_commandsBuffers[i]->descriptorInfo();
+    auto countsInfo = m_countsBuffers[i]->descriptorInfo();
+    auto pyramidInfo = m_depthPyramid->getDescriptorInfo();
+    auto occlusionInfo = m_occlusionBuffers[i]->descriptorInfo();
+    auto statsInfo = m_statsBuffers[i]->descriptorInfo();
+    auto pagesInfo = m_pagesBuffers[i]->descriptorInfo();
+    DescriptorWriterVk(*m_descriptorSetLayout, *m_descriptorPool)
+        .writeBuffer(0, &slotsInfo)
+        .writeBuffer(1, &commandsInfo)
+        .writeBuffer(2, &countsInfo)
+        .writeImage(3, &pyramidInfo)
+        .writeBuffer(4, &occlusionInfo)
+        .writeBuffer(5, &statsInfo)
+        .writeBuffer(6, &pagesInfo)
+        .build(m_descriptorSets[i]);
+  }
+}
+
+void ChunkCullingSystem::writeDepthPyramidDescriptors() {
+  ZoneScoped;
+  auto pyramidInfo = m_depthPyramid->getDescriptorInfo();
+  for (vk::DescriptorSet &descriptorSet : m_descriptorSets) {
+    DescriptorWriterVk(*m_descriptorSetLayout, *m_descriptorPool).writeImage(3, &pyramidInfo).overwrite(descriptorSet);
+  }
+}
+
+void ChunkCullingSystem::createPipelineLayout() {
+  ZoneScoped;
+  vk::PushConstantRange pushConstantRange = {
+      .stageFlags = vk::ShaderStageFlagBits::eCompute,
+      .offset = 0,
+      .size = sizeof(PushConstantData),
+  };
+
+  vk::DescriptorSetLayout descriptorSetLayout = m_descriptorSetLayout->getDescriptorSetLayout();
+  vk::PipelineLayoutCreateInfo pipelineLayoutInfo = {
+      .setLayoutCount = 1,
+      .pSetLayouts = &descriptorSetLayout,
+      .pushConstantRangeCount = 1,
+      .pPushConstantRanges = &pushConstantRange,
+  };
+
+  m_pipelineLayout = m_device->getDevice().createPipelineLayout(pipelineLayoutInfo);
+}
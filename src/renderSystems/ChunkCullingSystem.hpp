@@ -0,0 +1,198 @@
+#pragma once
+
+#include "../core/Frustum.hpp"
+#include "../core/NonCopyable.hpp"
+#include "../renderer/DepthPyramid.hpp"
+#include "../renderer/Mesh.hpp"
+#include "../renderer/backend/BufferVk.hpp"
+#include "../renderer/backend/ComputePipelineVk.hpp"
+#include "../renderer/backend/DescriptorsVk.hpp"
+#include "../renderer/backend/SwapChainVk.hpp"
+#include "../world/ChunksManager.hpp"
+#include "ChunkVertex.hpp"
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Отсечение секций чанков на GPU. Компьют-шейдер проверяет секции каждого слота таблицы по пирамиде видимости
+// и пишет команды отрисовки видимых отрезков секций, сгруппированные по страницам арены мешей,
+// ChunkRenderSystem рисует каждую страницу одним drawIndexedIndirectCount.
+// Таблица живёт между кадрами: поток рендера трогает только слоты сменившихся тайлов и загруженных мешей.
+// Секции в пирамиде видимости дополнительно проверяются по пирамиде глубины прошлого кадра, пока камера
+// с того кадра почти не сдвинулась; иначе остаётся только пирамида видимости.
+class ChunkCullingSystem : NonCopyable {
+public:
+  // Слот держит меш, для которого записаны его данные на GPU: новый меш чанка попадёт в слот вместе с данными
+  struct Slot {
+    std::shared_ptr<Chunk> chunk;
+    std::shared_ptr<Mesh<ChunkVertex>> mesh;
+  };
+  // Срез не шире квадрата наибольшего радиуса загрузки
+  static constexpr uint32_t MAX_SLOTS =
+      (ChunksManager::MAX_LOAD_RADIUS * 2 + 1) * (ChunksManager::MAX_LOAD_RADIUS * 2 + 1);
+  // Видимые отрезки секций разделены хотя бы одной невидимой
+  static constexpr uint32_t MAX_SLOT_COMMANDS = Chunk::SECTIONS_COUNT / 2;
+
+  // Камера кадра; frustum, projectionView и position - в координатах относительно чанка (playerX, playerZ)
+  struct View {
+    Frustum frustum;
+    glm::mat4 projectionView;
+    glm::vec3 position;
+    glm::vec3 front;
+    int playerX;
+    int playerZ;
+  };
+  // Треугольники кадра MAX_FRAMES_IN_FLIGHT кадров назад: результат читается, когда GPU его уже записал
+  struct Stats {
+    size_t frustumTriangles;
+    size_t drawnTriangles;
+    bool isOcclusionEnabled;
+  };
+  // Команды страницы арены в буфере команд кадра: [firstCommand, firstCommand + maxCommands),
+  // их фактическое число - в буфере счётчиков по номеру страницы
+  struct DrawPage {
+    uint32_t page;
+    uint32_t firstCommand;
+    uint32_t maxCommands;
+  };
+
+  ChunkCullingSystem(RenderDeviceVk *device);
+  ~ChunkCullingSystem();
+
+  // Приводит таблицу к срезу менеджера; перебираются только тайлы, сменившиеся с прошлого вызова
+  void syncChunks(const std::shared_ptr<const ChunksSnapshot> &snapshot);
+  // Переписывает слот чанка после загрузки меша; чанк без слота получит данные при синхронизации тайла
+  void updateChunk(const Chunk &chunk);
+  // Переписывает все занятые слоты: после MeshArena::compact смещения мешей в них устарели
+  void updateAllChunks();
+  // Вызывается до рендер-пасса: пишет команды кадра и ставит барьер перед их чтением.
+  // depthExtent - размер буфера глубины, под который держится пирамида
+  void cull(vk::CommandBuffer commandBuffer, size_t frameIndex, const View &view, vk::Extent2D depthExtent);
+  // Вызывается после рендер-пасса: строит пирамиду из глубины кадра для отсечения в следующем
+  void buildDepthPyramid(vk::CommandBuffer commandBuffer, size_t frameIndex, vk::ImageView depthView);
+
+  inline const std::vector<Slot> &getSlots() const noexcept { return m_slots; }
+  // Слоты с большими номерами свободны и шейдером не обходятся
+  inline uint32_t getSlotsCount() const noexcept { return m_slotsCount; }
+  inline size_t getChunksCount() const noexcept { return m_slotsByChunk.size(); }
+  inline const Stats &getStats() const noexcept { return m_stats; }
+  inline vk::Buffer getCommandsBuffer(size_t frameIndex) const noexcept {
+    return m_commandsBuffers[frameIndex]->getBuffer();
+  }
+  inline vk::Buffer getCountsBuffer(size_t frameIndex) const noexcept {
+    return m_countsBuffers[frameIndex]->getBuffer();
+  }
+  // Страницы, на которых есть меши слотов, на момент последнего cull
+  inline const std::vector<DrawPage> &getDrawPages() const noexcept { return m_drawPages; }
+  // Позиции чанков по номерам слотов: firstInstance команд - номер слота
+  inline vk::DescriptorBufferInfo getDrawsDescriptorInfo(size_t frameIndex) const {
+    return m_drawsBuffers[frameIndex]->descriptorInfo();
+  }
+
+private:
+  // Раскладка совпадает с ChunkSlot в chunk_cull.comp (std430)
+  struct GpuChunkSlot {
+    glm::ivec2 position;
+    uint32_t minY;
+    uint32_t maxY;
+    std::array<uint32_t, Chunk::SECTIONS_COUNT + 1> indexOffsets;
+    // Начало меша в странице арены
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    uint32_t page;
+  };
+  static_assert(sizeof(GpuChunkSlot) == 96);
+  // Раскладка совпадает с Occlusion в chunk_cull.comp (std140)
+  struct OcclusionData {
+    glm::mat4 projectionView;
+    glm::ivec2 viewChunk;
+    glm::vec2 depthSize;
+    int32_t mipLevels;
+    uint32_t isEnabled;
+    glm::vec2 padding;
+  };
+  static_assert(sizeof(OcclusionData) == 96);
+  struct GpuStats {
+    uint32_t frustumIndices;
+    uint32_t drawnIndices;
+  };
+  struct PushConstantData {
+    std::array<glm::vec4, 6> frustumPlanes;
+    glm::ivec2 playerChunk;
+    uint32_t slotsCount;
+  };
+  static constexpr uint32_t WORKGROUP_SIZE = 64;
+  // Буферы счётчиков и начал команд страниц растут вместе с ареной, но не меньше этого
+  static constexpr uint32_t MIN_PAGES_CAPACITY = 4;
+  static constexpr uint8_t ALL_FRAMES_MASK = (1u << SwapChainVk::MAX_FRAMES_IN_FLIGHT) - 1;
+  // Дальше этого сдвига камеры от кадра пирамиды (в блоках) или поворота (косинус угла ~2 градусов)
+  // перекрытия по старой глубине ненадёжны
+  static constexpr float MAX_OCCLUSION_SHIFT = 2.0f;
+  static constexpr float MIN_OCCLUSION_FRONT_COS = 0.9994f;
+
+  void createBuffers();
+  // Пересоздаёт буферы страниц кадра, если в них не помещаются все страницы с мешами слотов
+  void reservePages(size_t frameIndex);
+  void createDescriptorSets();
+  void createPipelineLayout();
+  void writeDepthPyramidDescriptors();
+  // Раскладывает команды по страницам пропорционально числу их слотов
+  void updateDrawPages(size_t frameIndex);
+  bool isOcclusionReliable(const View &view) const noexcept;
+  void acquireSlot(const std::shared_ptr<Chunk> &chunk);
+  void releaseSlot(const Chunk *chunk);
+  // Пересобирает данные слота по текущему мешу чанка и помечает их для записи во все кадры
+  void writeSlot(uint32_t slotIdx);
+  void retireMesh(std::shared_ptr<Mesh<ChunkVertex>> mesh);
+
+  RenderDeviceVk *m_device;
+  std::unique_ptr<DescriptorPoolVk> m_descriptorPool;
+  std::unique_ptr<DescriptorSetLayoutVk> m_descriptorSetLayout;
+  std::array<vk::DescriptorSet, SwapChainVk::MAX_FRAMES_IN_FLIGHT> m_descriptorSets;
+  vk::PipelineLayout m_pipelineLayout;
+  std::unique_ptr<ComputePipelineVk> m_pipeline;
+  // Свой набор буферов на каждый кадр в полёте: запись следующего кадра не ждёт чтения предыдущего
+  std::array<std::unique_ptr<BufferVk>, SwapChainVk::MAX_FRAMES_IN_FLIGHT> m_slotsBuffers;
+  std::array<std::unique_ptr<BufferVk>, SwapChainVk::MAX_FRAMES_IN_FLIGHT> m_commandsBuffers;
+  std::array<std::unique_ptr<BufferVk>, SwapChainVk::MAX_FRAMES_IN_FLIGHT> m_countsBuffers;
+  std::array<std::unique_ptr<BufferVk>, SwapChainVk::MAX_FRAMES_IN_FLIGHT> m_pagesBuffers;
+  std::array<uint32_t, SwapChainVk::MAX_FRAMES_IN_FLIGHT> m_pagesCapacities = {};
+  std::array<std::unique_ptr<BufferVk>, SwapChainVk::MAX_FRAMES_IN_FLIGHT> m_drawsBuffers;
+  std::array<std::unique_ptr<BufferVk>, SwapChainVk::MAX_FRAMES_IN_FLIGHT> m_occlusionBuffers;
+  std::array<std::unique_ptr<BufferVk>, SwapChainVk::MAX_FRAMES_IN_FLIGHT> m_statsBuffers;
+  std::unique_ptr<DepthPyramid> m_depthPyramid;
+  View m_frameView = {};
+  // Камера кадра, из глубины которого построена пирамида; nullopt - пирамида пуста или пересоздана
+  std::optional<View> m_pyramidView;
+  Stats m_stats = {};
+
+  std::shared_ptr<const ChunksSnapshot> m_snapshot;
+  std::unordered_map<uint64_t, std::shared_ptr<ChunksTile>> m_tiles;
+  std::unordered_map<uint64_t, std::shared_ptr<ChunksTile>> m_nextTiles;
+  // Тайлы нового среза, которых не было в прошлом; живут в m_nextTiles
+  std::vector<const ChunksTile *> m_changedTiles;
+  std::vector<Slot> m_slots;
+  std::vector<GpuChunkSlot> m_slotsData;
+  uint32_t m_slotsCount = 0;
+  // Слоты с мешами на каждой странице арены; растёт до последней страницы, на которой был меш слота
+  std::vector<uint32_t> m_pageSlotsCounts;
+  std::vector<uint32_t> m_pageFirstCommands;
+  std::vector<DrawPage> m_drawPages;
+  std::vector<uint32_t> m_freeSlots;
+  std::unordered_map<const Chunk *, uint32_t> m_slotsByChunk;
+  // Бит на кадр в полёте: данные слота ещё не записаны в буфер этого кадра
+  std::vector<uint8_t> m_slotDirtyFrames;
+  // Слоты, чей меш ещё загружается: до готовности слот пуст, а затем переписывается в cull
+  std::vector<uint32_t> m_uploadingSlots;
+  // Слот уже в m_uploadingSlots
+  std::vector<uint8_t> m_isSlotUploading;
+  std::array<std::vector<uint32_t>, SwapChainVk::MAX_FRAMES_IN_FLIGHT> m_dirtySlots;
+  // Вытесненные из слотов меши живут, пока их могут читать кадры в полёте
+  std::deque<std::pair<uint64_t, std::shared_ptr<Mesh<ChunkVertex>>>> m_retiredMeshes;
+  uint64_t m_frame = 0;
+};
@@ -5,11 +5,18 @@
 #include <vulkan/vulkan_enums.hpp>
 
 ChunkRenderSystem::ChunkRenderSystem(RenderDeviceVk *device, vk::RenderPass renderPass,
-                                     vk::DescriptorSetLayout descriptorSetLayout)
-    : m_device{device} {
+                                     vk::DescriptorSetLayout descriptorSetLayout, RenderQueue *renderQueue,
+                                     MeshArena *meshArena, ChunkCullingSystem *cullingSystem)
+    : m_device{device}, m_renderQueue{renderQueue}, m_meshArena{meshArena}, m_cullingSystem{cullingSystem} {
   ZoneScoped;
+  if (!m_cullingSystem) {
+    createDrawBuffers();
+  }
+  createDescriptorSets();
   createPipelineLayout(descriptorSetLayout);
   createPipeline(renderPass);
+  m_queuePipeline = m_renderQueue->registerPipeline(
+      [this](FrameData &frameData, std::span<const uint32_t> payloads) { draw(frameData, payloads); });
 }
 
 ChunkRenderSystem::~ChunkRenderSystem() {
@@ -17,38 +24,196 @@ ChunkRenderSystem::~ChunkRenderSystem() {
   m_device->getDevice().destroyPipelineLayout(m_pipelineLayout);
 }
 
-void ChunkRenderSystem::render(FrameData &frameData) {
+void ChunkRenderSystem::submit(FrameData &frameData) {
+  ZoneScoped;
+  if (m_cullingSystem) {
+    // Порядок внутри страницы задают атомики шейдера отсечения, сортировать на CPU нечего
+    for (size_t i = 0; i < m_cullingSystem->getDrawPages().size(); i++) {
+      m_renderQueue->submit(RenderQueue::makeKey(DrawPass::Opaque, m_queuePipeline, 0.0f), static_cast<uint32_t>(i));
+    }
+    return;
+  }
+  for (size_t i = 0; i < frameData.chunks.size(); i++) {
+    const auto &chunk = frameData.chunks[i];
+    if (chunk->getMesh() && chunk->getMesh()->isReady()) {
+      m_renderQueue->submit(RenderQueue::makeKey(DrawPass::Opaque, m_queuePipeline, getDepth(frameData, *chunk)),
+                            static_cast<uint32_t>(i));
+    }
+  }
+  m_draws.clear();
+  m_commands.clear();
+  m_frameMeshes[frameData.frameIndex].clear();
+}
+
+void ChunkRenderSystem::draw(FrameData &frameData, std::span<const uint32_t> payloads) {
   ZoneScoped;
   m_pipeline->bind(frameData.commandBuffer);
 
-  frameData.commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout, 0, 1,
-                                             &frameData.globalDescriptorSet, 0, nullptr);
+  std::array<vk::DescriptorSet, 2> descriptorSets = {frameData.globalDescriptorSet,
+                                                     m_drawsDescriptorSets[frameData.frameIndex]};
+  frameData.commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout, 0,
+                                             static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 0,
+                                             nullptr);
+  PushConstantData push = {.playerChunk = {frameData.playerX, frameData.playerZ}};
+  frameData.commandBuffer.pushConstants(m_pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0,
+                                        sizeof(PushConstantData), &push);
+
+  if (m_cullingSystem) {
+    drawCulledPages(frameData, payloads);
+  } else {
+    drawChunks(frameData, payloads);
+  }
+}
+
+void ChunkRenderSystem::drawCulledPages(FrameData &frameData, std::span<const uint32_t> payloads) {
+  ZoneScoped;
+  const vk::Buffer commandsBuffer = m_cullingSystem->getCommandsBuffer(frameData.frameIndex);
+  const vk::Buffer countsBuffer = m_cullingSystem->getCountsBuffer(frameData.frameIndex);
+  const auto &drawPages = m_cullingSystem->getDrawPages();
+  for (const uint32_t i : payloads) {
+    const auto &drawPage = drawPages[i];
+    m_meshArena->bind(frameData.commandBuffer, drawPage.page);
+    frameData.commandBuffer.drawIndexedIndirectCount(
+        commandsBuffer, drawPage.firstCommand * sizeof(vk::DrawIndexedIndirectCommand), countsBuffer,
+        drawPage.page * sizeof(uint32_t), drawPage.maxCommands, sizeof(vk::DrawIndexedIndirectCommand));
+  }
+}
+
+void ChunkRenderSystem::drawChunks(FrameData &frameData, std::span<const uint32_t> payloads) {
+  ZoneScoped;
+  BufferVk &drawsBuffer = *m_drawsBuffers[frameData.frameIndex];
+  BufferVk &commandsBuffer = *m_commandsBuffers[frameData.frameIndex];
+  const size_t firstDraw = m_draws.size();
+  for (auto &commands : m_pageCommands) {
+    commands.clear();
+  }
 
-  for (auto &chunk : frameData.chunks) {
-    PushConstantData push = {
-        .chunkPos = {(chunk->x() - frameData.playerX) * Chunk::CHUNK_SIZE,
-                     (chunk->z() - frameData.playerZ) * Chunk::CHUNK_SIZE},
+  for (const uint32_t i : payloads) {
+    if (m_draws.size() >= MAX_DRAWS) {
+      break;
+    }
+    const auto &chunk = frameData.chunks[i];
+    const auto &mesh = chunk->getMesh();
+    const MeshArena::Range *range = mesh ? mesh->getArenaRange() : nullptr;
+    if (range == nullptr || !mesh->isReady()) {
+      continue;
+    }
+    if (range->page >= m_pageCommands.size()) {
+      m_pageCommands.resize(range->page + 1);
+    }
+    // Команды раскладываются по страницам, внутри страницы сохраняя порядок от ближних к дальним
+    auto &pageCommands = m_pageCommands[range->page];
+    const uint32_t drawIdx = static_cast<uint32_t>(m_draws.size());
+    m_draws.emplace_back(chunk->x(), chunk->z());
+    m_frameMeshes[frameData.frameIndex].push_back(mesh);
+    auto addCommand = [&](uint32_t firstIndex, uint32_t indexCount) {
+      pageCommands.push_back({
+          .indexCount = indexCount,
+          .instanceCount = 1,
+          .firstIndex = range->firstIndex + firstIndex,
+          .vertexOffset = range->vertexOffset,
+          .firstInstance = drawIdx,
+      });
     };
-    frameData.commandBuffer.pushConstants(m_pipelineLayout,
-                                          vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0,
-                                          sizeof(PushConstantData), &push);
-    if (chunk->getMesh() != nullptr) {
-      chunk->getMesh()->bind(frameData.commandBuffer);
-      chunk->getMesh()->draw(frameData.commandBuffer);
+    const uint16_t visibleSections =
+        i < frameData.chunkVisibleSections.size() ? frameData.chunkVisibleSections[i] : 0xFFFF;
+    const auto sections = chunk->getMeshSections();
+    if (visibleSections == 0xFFFF || !sections) {
+      addCommand(0, range->indexCount);
+      continue;
     }
+    // Соседние видимые секции лежат в буфере индексов подряд и рисуются одной командой
+    for (int first = 0; first < Chunk::SECTIONS_COUNT;) {
+      if (!(visibleSections & (1u << first))) {
+        first++;
+        continue;
+      }
+      int last = first;
+      while (last + 1 < Chunk::SECTIONS_COUNT && (visibleSections & (1u << (last + 1)))) {
+        last++;
+      }
+      const uint32_t firstIndex = sections->indexOffsets[first];
+      const uint32_t indexCount = sections->indexOffsets[last + 1] - firstIndex;
+      if (indexCount > 0) {
+        addCommand(firstIndex, indexCount);
+      }
+      first = last + 1;
+    }
+  }
+  for (uint32_t page = 0; page < m_pageCommands.size(); page++) {
+    const auto &pageCommands = m_pageCommands[page];
+    if (pageCommands.empty()) {
+      continue;
+    }
+    const size_t firstCommand = m_commands.size();
+    m_commands.insert(m_commands.end(), pageCommands.begin(), pageCommands.end());
+    const uint32_t count = static_cast<uint32_t>(pageCommands.size());
+    const vk::DeviceSize offset = firstCommand * sizeof(vk::DrawIndexedIndirectCommand);
+    commandsBuffer.writeToBuffer(&m_commands[firstCommand], count * sizeof(vk::DrawIndexedIndirectCommand), offset);
+    m_meshArena->bind(frameData.commandBuffer, page);
+    frameData.commandBuffer.drawIndexedIndirect(commandsBuffer.getBuffer(), offset, count,
+                                                sizeof(vk::DrawIndexedIndirectCommand));
+  }
+  if (m_draws.size() > firstDraw) {
+    drawsBuffer.writeToBuffer(&m_draws[firstDraw], (m_draws.size() - firstDraw) * sizeof(glm::ivec2),
+                              firstDraw * sizeof(glm::ivec2));
+  }
+}
+
+float ChunkRenderSystem::getDepth(const FrameData &frameData, const Chunk &chunk) noexcept {
+  // Квадрат расстояния до центра меша: ключу важен только порядок
+  const VerticalBounds bounds = chunk.getMeshBounds();
+  const glm::vec3 center(static_cast<float>((chunk.x() - frameData.playerX) * Chunk::CHUNK_SIZE) +
+                             Chunk::CHUNK_SIZE * 0.5f,
+                         static_cast<float>(bounds.minY + bounds.maxY) * 0.5f,
+                         static_cast<float>((chunk.z() - frameData.playerZ) * Chunk::CHUNK_SIZE) +
+                             Chunk::CHUNK_SIZE * 0.5f);
+  const glm::vec3 offset = center - frameData.cameraPosition;
+  return glm::dot(offset, offset);
+}
+
+void ChunkRenderSystem::createDrawBuffers() {
+  ZoneScoped;
+  m_draws.reserve(MAX_DRAWS);
+  m_commands.reserve(MAX_COMMANDS);
+  for (size_t i = 0; i < SwapChainVk::MAX_FRAMES_IN_FLIGHT; i++) {
+    m_drawsBuffers[i] =
+        std::make_unique<BufferVk>(m_device, sizeof(glm::ivec2), MAX_DRAWS, vk::BufferUsageFlagBits::eStorageBuffer,
+                                   VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+    m_commandsBuffers[i] = std::make_unique<BufferVk>(
+        m_device, sizeof(vk::DrawIndexedIndirectCommand), MAX_COMMANDS, vk::BufferUsageFlagBits::eIndirectBuffer,
+        VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+  }
+}
+
+void ChunkRenderSystem::createDescriptorSets() {
+  ZoneScoped;
+  m_descriptorPool = DescriptorPoolVk::Builder(m_device)
+                         .setMaxSets(SwapChainVk::MAX_FRAMES_IN_FLIGHT)
+                         .addPoolSize(vk::DescriptorType::eStorageBuffer, SwapChainVk::MAX_FRAMES_IN_FLIGHT)
+                         .build();
+  m_drawsSetLayout = DescriptorSetLayoutVk::Builder(m_device)
+                         .addBinding(0, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eVertex)
+                         .build();
+  for (size_t i = 0; i < SwapChainVk::MAX_FRAMES_IN_FLIGHT; i++) {
+    auto drawsInfo =
+        m_cullingSystem ? m_cullingSystem->getDrawsDescriptorInfo(i) : m_drawsBuffers[i]->descriptorInfo();
+    DescriptorWriterVk(*m_drawsSetLayout, *m_descriptorPool)
+        .writeBuffer(0, &drawsInfo)
+        .build(m_drawsDescriptorSets[i]);
   }
-  m_prevChunksToRender[frameData.frameIndex] = frameData.chunks;
 }
 
 void ChunkRenderSystem::createPipelineLayout(vk::DescriptorSetLayout descriptorSetLayout) {
   ZoneScoped;
   vk::PushConstantRange pushConstantRange = {
-      .stageFlags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+      .stageFlags = vk::ShaderStageFlagBits::eVertex,
       .offset = 0,
       .size = sizeof(PushConstantData),
   };
 
-  std::vector<vk::DescriptorSetLayout> descriptorSetLayouts{descriptorSetLayout};
+  std::vector<vk::DescriptorSetLayout> descriptorSetLayouts{descriptorSetLayout,
+                                                            m_drawsSetLayout->getDescriptorSetLayout()};
 
   vk::PipelineLayoutCreateInfo pipelineLayoutInfo = {
       .setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size()),
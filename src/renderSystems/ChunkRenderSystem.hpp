@@ -1,9 +1,13 @@
 #pragma once
 
 #include "../core/NonCopyable.hpp"
+#include "../renderer/backend/BufferVk.hpp"
+#include "../renderer/backend/DescriptorsVk.hpp"
 #include "../renderer/backend/PipelineVk.hpp"
 #include "../renderer/backend/SwapChainVk.hpp"
 #include "../world/Chunk.hpp"
+#include "ChunkCullingSystem.hpp"
+#include "RenderQueue.hpp"
 #include "glm/fwd.hpp"
 #include <array>
 #include <cstddef>
@@ -13,36 +17,71 @@
 #include <vulkan/vulkan_core.h>
 
 struct PushConstantData {
-  glm::vec2 chunkPos;
+  glm::ivec2 playerChunk;
 };
 
 struct FrameData {
   vk::CommandBuffer commandBuffer;
   std::vector<std::shared_ptr<Chunk>> chunks;
+  // Маска видимых секций для каждого чанка из chunks; если пусто - рисуются чанки целиком
+  std::vector<uint16_t> chunkVisibleSections;
   int playerX;
   int playerZ;
+  // В координатах относительно чанка (playerX, playerZ), для глубины в ключах сортировки
+  glm::vec3 cameraPosition;
   vk::DescriptorSet globalDescriptorSet;
   size_t frameIndex;
 };
 
+// Все чанки рисуются непрямыми отрисовками из общего буфера команд, по вызову на страницу арены мешей:
+// позицию чанка вершинный шейдер берёт из буфера по gl_InstanceIndex, firstInstance команды - её номер.
+// Число команд Vulkan на кадр не зависит от числа чанков.
 class ChunkRenderSystem : NonCopyable {
 public:
-  ChunkRenderSystem(RenderDeviceVk *device, vk::RenderPass renderPass,
-                    vk::DescriptorSetLayout descriptorSetLayout);
+  // cullingSystem - команды пишет компьют-шейдер отсечения; nullptr - команды собираются на CPU из frameData.chunks
+  ChunkRenderSystem(RenderDeviceVk *device, vk::RenderPass renderPass, vk::DescriptorSetLayout descriptorSetLayout,
+                    RenderQueue *renderQueue, MeshArena *meshArena, ChunkCullingSystem *cullingSystem);
   ~ChunkRenderSystem();
 
-  void render(FrameData &frameData);
+  // Без отсечения на GPU ставит в очередь по отрисовке на чанк с мешем, ближние чанки рисуются первыми;
+  // с ним - по отрисовке на страницу арены
+  void submit(FrameData &frameData);
 
 private:
+  // Чанков в списке кадра не больше, чем слотов в таблице отсечения
+  static constexpr uint32_t MAX_DRAWS = ChunkCullingSystem::MAX_SLOTS;
+  static constexpr uint32_t MAX_COMMANDS = MAX_DRAWS * ChunkCullingSystem::MAX_SLOT_COMMANDS;
+
   void createPipelineLayout(vk::DescriptorSetLayout descriptorSetLayout);
   void createPipeline(vk::RenderPass renderPass);
+  void createDrawBuffers();
+  void createDescriptorSets();
+  // payloads - номера в frameData.chunks или в ChunkCullingSystem::getDrawPages
+  void draw(FrameData &frameData, std::span<const uint32_t> payloads);
+  void drawCulledPages(FrameData &frameData, std::span<const uint32_t> payloads);
+  // Пишет команды видимых секций чанков в буферы кадра и рисует их по вызову на страницу арены
+  void drawChunks(FrameData &frameData, std::span<const uint32_t> payloads);
+  static float getDepth(const FrameData &frameData, const Chunk &chunk) noexcept;
 
 private:
   RenderDeviceVk *m_device;
+  RenderQueue *m_renderQueue;
+  MeshArena *m_meshArena;
+  ChunkCullingSystem *m_cullingSystem;
+  uint32_t m_queuePipeline;
   std::unique_ptr<PipelineVk> m_pipeline;
+  std::unique_ptr<DescriptorPoolVk> m_descriptorPool;
+  std::unique_ptr<DescriptorSetLayoutVk> m_drawsSetLayout;
+  std::array<vk::DescriptorSet, SwapChainVk::MAX_FRAMES_IN_FLIGHT> m_drawsDescriptorSets;
   vk::PipelineLayout m_pipelineLayout;
-  // Нужно, чтобы буффер с мешем не удалился до отрисовки кадра
-  std::array<std::vector<std::shared_ptr<Chunk>>,
-             SwapChainVk::MAX_FRAMES_IN_FLIGHT>
-      m_prevChunksToRender;
+  // Позиции и команды отрисовок без отсечения на GPU; пишутся на CPU за кадр
+  std::array<std::unique_ptr<BufferVk>, SwapChainVk::MAX_FRAMES_IN_FLIGHT> m_drawsBuffers;
+  std::array<std::unique_ptr<BufferVk>, SwapChainVk::MAX_FRAMES_IN_FLIGHT> m_commandsBuffers;
+  std::vector<glm::ivec2> m_draws;
+  std::vector<vk::DrawIndexedIndirectCommand> m_commands;
+  // Команды одного вызова drawChunks по страницам арены, до переноса в m_commands
+  std::vector<std::vector<vk::DrawIndexedIndirectCommand>> m_pageCommands;
+  // Меши, нарисованные в кадре: перемешивание заменяет меш чанка, и без ссылки его место в арене
+  // освободилось бы, пока кадр ещё читает его на GPU
+  std::array<std::vector<std::shared_ptr<Mesh<ChunkVertex>>>, SwapChainVk::MAX_FRAMES_IN_FLIGHT> m_frameMeshes;
 };
\ No newline at end of file
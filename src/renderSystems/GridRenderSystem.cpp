@@ -4,12 +4,14 @@
 #include <vulkan/vulkan_enums.hpp>
 
 GridRenderSystem::GridRenderSystem(RenderDeviceVk *device, vk::RenderPass renderPass,
-                                   vk::DescriptorSetLayout descriptorSetLayout)
-    : m_device{device} {
+                                   vk::DescriptorSetLayout descriptorSetLayout, RenderQueue *renderQueue)
+    : m_device{device}, m_renderQueue{renderQueue} {
   ZoneScoped;
   createPipelineLayout(descriptorSetLayout);
   createPipeline(renderPass);
   m_mesh = std::make_unique<Mesh<GridVertex>>(m_device, m_vertices, m_indices);
+  m_queuePipeline = m_renderQueue->registerPipeline(
+      [this](FrameData &frameData, std::span<const uint32_t>) { draw(frameData); });
 }
 
 GridRenderSystem::~GridRenderSystem() {
@@ -17,7 +19,17 @@ GridRenderSystem::~GridRenderSystem() {
   m_device->getDevice().destroyPipelineLayout(m_pipelineLayout);
 }
 
-void GridRenderSystem::render(FrameData &frameData) {
+void GridRenderSystem::submit(FrameData &frameData) {
+  // Первые кадры меш ещё загружается
+  if (!m_mesh->isReady()) {
+    return;
+  }
+  // Расстояние до центра плоскости сетки
+  const float depth = glm::length(frameData.cameraPosition);
+  m_renderQueue->submit(RenderQueue::makeKey(DrawPass::Translucent, m_queuePipeline, depth), 0);
+}
+
+void GridRenderSystem::draw(FrameData &frameData) {
   ZoneScoped;
   m_pipeline->bind(frameData.commandBuffer);
 
@@ -30,17 +30,22 @@ struct GridVertex {
 
 class GridRenderSystem : NonCopyable {
 public:
-  GridRenderSystem(RenderDeviceVk *device, vk::RenderPass renderPass, vk::DescriptorSetLayout descriptorSetLayout);
+  GridRenderSystem(RenderDeviceVk *device, vk::RenderPass renderPass, vk::DescriptorSetLayout descriptorSetLayout,
+                   RenderQueue *renderQueue);
   ~GridRenderSystem();
 
-  void render(FrameData &frameData);
+  // Сетка полупрозрачная и рисуется в прозрачном проходе
+  void submit(FrameData &frameData);
 
 private:
   void createPipelineLayout(vk::DescriptorSetLayout descriptorSetLayout);
   void createPipeline(vk::RenderPass renderPass);
+  void draw(FrameData &frameData);
 
 private:
   RenderDeviceVk *m_device;
+  RenderQueue *m_renderQueue;
+  uint32_t m_queuePipeline;
   std::unique_ptr<PipelineVk> m_pipeline;
   vk::PipelineLayout m_pipelineLayout;
 
@@ -0,0 +1,99 @@
+#include "RenderQueue.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <tracy/Tracy.hpp>
+
+namespace {
+constexpr uint32_t PASS_SHIFT = 62;
+constexpr uint64_t PIPELINE_MASK = RenderQueue::MAX_PIPELINES - 1;
+constexpr uint64_t DEPTH_MASK = (1u << 24) - 1;
+// Сдвиги полей в раскладках непрозрачных и прозрачных ключей
+constexpr uint32_t OPAQUE_PIPELINE_SHIFT = 48;
+constexpr uint32_t OPAQUE_DEPTH_SHIFT = 24;
+constexpr uint32_t TRANSLUCENT_DEPTH_SHIFT = 38;
+constexpr uint32_t TRANSLUCENT_PIPELINE_SHIFT = 24;
+
+inline DrawPass getPass(uint64_t key) noexcept { return static_cast<DrawPass>(key >> PASS_SHIFT); }
+} // namespace
+
+uint32_t RenderQueue::registerPipeline(BatchRenderer renderer) {
+  assert(m_renderers.size() < MAX_PIPELINES && "Too many pipelines in render queue");
+  m_renderers.push_back(std::move(renderer));
+  return static_cast<uint32_t>(m_renderers.size() - 1);
+}
+
+uint64_t RenderQueue::makeKey(DrawPass pass, uint32_t pipeline, float depth, uint32_t material) noexcept {
+  assert(pipeline < MAX_PIPELINES && material <= MAX_MATERIAL);
+  // Биты неотрицательного float растут вместе с числом: старшие 24 бита сохраняют порядок
+  // с 15 битами мантиссы, то есть ведро глубины - примерно 1/30000 расстояния
+  const uint64_t depthBits = std::bit_cast<uint32_t>(std::max(depth, 0.0f)) >> 7;
+  const uint64_t passBits = static_cast<uint64_t>(pass) << PASS_SHIFT;
+  if (pass == DrawPass::Translucent) {
+    return passBits | ((DEPTH_MASK - depthBits) << TRANSLUCENT_DEPTH_SHIFT) |
+           (static_cast<uint64_t>(pipeline) << TRANSLUCENT_PIPELINE_SHIFT) | material;
+  }
+  return passBits | (static_cast<uint64_t>(pipeline) << OPAQUE_PIPELINE_SHIFT) | (depthBits << OPAQUE_DEPTH_SHIFT) |
+         material;
+}
+
+uint32_t RenderQueue::getPipeline(uint64_t key) noexcept {
+  const uint32_t shift = getPass(key) == DrawPass::Translucent ? TRANSLUCENT_PIPELINE_SHIFT : OPAQUE_PIPELINE_SHIFT;
+  return static_cast<uint32_t>((key >> shift) & PIPELINE_MASK);
+}
+
+void RenderQueue::execute(FrameData &frameData) {
+  ZoneScoped;
+  m_drawsCount = m_draws.size();
+  m_batchesCount = 0;
+  sortDraws();
+  for (size_t first = 0; first < m_draws.size();) {
+    const DrawPass pass = getPass(m_draws[first].key);
+    const uint32_t pipeline = getPipeline(m_draws[first].key);
+    m_payloads.clear();
+    size_t last = first;
+    while (last < m_draws.size() && getPass(m_draws[last].key) == pass && getPipeline(m_draws[last].key) == pipeline) {
+      m_payloads.push_back(m_draws[last].payload);
+      last++;
+    }
+    m_renderers[pipeline](frameData, m_payloads);
+    m_batchesCount++;
+    first = last;
+  }
+  m_draws.clear();
+}
+
+void RenderQueue::sortDraws() {
+  ZoneScoped;
+  if (m_draws.size() < 2) {
+    return;
+  }
+  constexpr size_t BYTES_COUNT = sizeof(uint64_t);
+  constexpr uint64_t RADIX_MASK = RADIX_SIZE - 1;
+  // Гистограммы всех байтов за один проход по ключам
+  std::array<std::array<uint32_t, RADIX_SIZE>, BYTES_COUNT> histograms = {};
+  for (const Draw &draw : m_draws) {
+    for (size_t byte = 0; byte < BYTES_COUNT; byte++) {
+      histograms[byte][(draw.key >> (byte * RADIX_BITS)) & RADIX_MASK]++;
+    }
+  }
+  m_sortedDraws.resize(m_draws.size());
+  for (size_t byte = 0; byte < BYTES_COUNT; byte++) {
+    auto &histogram = histograms[byte];
+    const uint32_t shift = static_cast<uint32_t>(byte * RADIX_BITS);
+    if (histogram[(m_draws.front().key >> shift) & RADIX_MASK] == m_draws.size()) {
+      continue;
+    }
+    uint32_t offset = 0;
+    for (uint32_t &count : histogram) {
+      const uint32_t bucketSize = count;
+      count = offset;
+      offset += bucketSize;
+    }
+    for (const Draw &draw : m_draws) {
+      m_sortedDraws[histogram[(draw.key >> shift) & RADIX_MASK]++] = draw;
+    }
+    std::swap(m_draws, m_sortedDraws);
+  }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "../core/NonCopyable.hpp"
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+struct FrameData;
+
+// Проходы в порядке отрисовки
+enum class DrawPass : uint8_t {
+  // Без теста глубины, под всем остальным
+  Background = 0,
+  Opaque = 1,
+  Translucent = 2,
+};
+
+// Отрисовки всех систем рендера за кадр. Каждая отрисовка несёт 64-битный ключ, очередь сортирует их
+// поразрядно и отдаёт системам подряд идущие отрисовки одного конвейера пачкой.
+// Раскладка ключа от старших битов:
+//   непрозрачные: проход (2) | конвейер (14) | глубина (24) | материал (24) - спереди назад внутри конвейера
+//   прозрачные:   проход (2) | глубина (24, инвертирована) | конвейер (14) | материал (24) - сзади вперёд
+class RenderQueue : NonCopyable {
+public:
+  // Рисует пачку отрисовок одного конвейера в порядке ключей; payloads - то, что система передала в submit
+  using BatchRenderer = std::function<void(FrameData &frameData, std::span<const uint32_t> payloads)>;
+
+  static constexpr uint32_t MAX_PIPELINES = 1u << 14;
+  static constexpr uint32_t MAX_MATERIAL = (1u << 24) - 1;
+
+  // Возвращает номер конвейера для ключей; регистрируется один раз при создании системы
+  uint32_t registerPipeline(BatchRenderer renderer);
+  // depth - любое неотрицательное расстояние от камеры, важен только порядок
+  static uint64_t makeKey(DrawPass pass, uint32_t pipeline, float depth, uint32_t material = 0) noexcept;
+
+  inline void submit(uint64_t key, uint32_t payload) { m_draws.push_back({key, payload}); }
+  // Сортирует отрисовки кадра, рисует их и очищает очередь
+  void execute(FrameData &frameData);
+
+  inline size_t getDrawsCount() const noexcept { return m_drawsCount; }
+  inline size_t getBatchesCount() const noexcept { return m_batchesCount; }
+
+private:
+  struct Draw {
+    uint64_t key;
+    uint32_t payload;
+  };
+  static constexpr uint32_t RADIX_BITS = 8;
+  static constexpr uint32_t RADIX_SIZE = 1u << RADIX_BITS;
+
+  // Поразрядная сортировка от младшего байта, устойчивая; байты, одинаковые у всех ключей, пропускаются
+  void sortDraws();
+  static uint32_t getPipeline(uint64_t key) noexcept;
+
+  std::vector<BatchRenderer> m_renderers;
+  std::vector<Draw> m_draws;
+  // Буферы живут между кадрами, чтобы сортировка не выделяла память
+  std::vector<Draw> m_sortedDraws;
+  std::vector<uint32_t> m_payloads;
+  size_t m_drawsCount = 0;
+  size_t m_batchesCount = 0;
+};
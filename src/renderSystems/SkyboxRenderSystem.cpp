@@ -4,12 +4,14 @@
 #include <vulkan/vulkan_enums.hpp>
 
 SkyboxRenderSystem::SkyboxRenderSystem(RenderDeviceVk *device, vk::RenderPass renderPass,
-                                       vk::DescriptorSetLayout descriptorSetLayout)
-    : m_device{device} {
+                                       vk::DescriptorSetLayout descriptorSetLayout, RenderQueue *renderQueue)
+    : m_device{device}, m_renderQueue{renderQueue} {
   ZoneScoped;
   createPipelineLayout(descriptorSetLayout);
   createPipeline(renderPass);
   m_mesh = std::make_unique<Mesh<SkyboxVertex>>(m_device, m_vertices, m_indices);
+  m_queuePipeline = m_renderQueue->registerPipeline(
+      [this](FrameData &frameData, std::span<const uint32_t>) { draw(frameData); });
 }
 
 SkyboxRenderSystem::~SkyboxRenderSystem() {
@@ -17,7 +19,15 @@ SkyboxRenderSystem::~SkyboxRenderSystem() {
   m_device->getDevice().destroyPipelineLayout(m_pipelineLayout);
 }
 
-void SkyboxRenderSystem::render(FrameData &frameData) {
+void SkyboxRenderSystem::submit(FrameData &frameData) {
+  // Первые кадры меш ещё загружается
+  if (!m_mesh->isReady()) {
+    return;
+  }
+  m_renderQueue->submit(RenderQueue::makeKey(DrawPass::Background, m_queuePipeline, 0.0f), 0);
+}
+
+void SkyboxRenderSystem::draw(FrameData &frameData) {
   ZoneScoped;
   m_pipeline->bind(frameData.commandBuffer);
 
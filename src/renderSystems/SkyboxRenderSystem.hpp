@@ -29,17 +29,22 @@ class SkyboxRenderSystem {
   };
 
 public:
-  SkyboxRenderSystem(RenderDeviceVk *device, vk::RenderPass renderPass, vk::DescriptorSetLayout descriptorSetLayout);
+  SkyboxRenderSystem(RenderDeviceVk *device, vk::RenderPass renderPass, vk::DescriptorSetLayout descriptorSetLayout,
+                     RenderQueue *renderQueue);
   ~SkyboxRenderSystem();
 
-  void render(FrameData &frameData);
+  // Небо рисуется первым проходом: теста глубины у него нет
+  void submit(FrameData &frameData);
 
 private:
   void createPipelineLayout(vk::DescriptorSetLayout descriptorSetLayout);
   void createPipeline(vk::RenderPass renderPass);
+  void draw(FrameData &frameData);
 
 private:
   RenderDeviceVk *m_device;
+  RenderQueue *m_renderQueue;
+  uint32_t m_queuePipeline;
   std::unique_ptr<PipelineVk> m_pipeline;
   vk::PipelineLayout m_pipelineLayout;
   std::unique_ptr<Mesh<SkyboxVertex>> m_mesh;
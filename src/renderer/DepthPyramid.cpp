@@ -0,0 +1,219 @@
+#include "DepthPyramid.hpp"
+#include <tracy/Tracy.hpp>
+
+namespace {
+// Запись уровня после чтения: предыдущим уровнем, отсечением этого кадра или прошлым построением
+void addComputeBarrier(vk::CommandBuffer commandBuffer, vk::AccessFlags srcAccessMask, vk::AccessFlags dstAccessMask) {
+  vk::MemoryBarrier barrier = {.srcAccessMask = srcAccessMask, .dstAccessMask = dstAccessMask};
+  commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+                                {}, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+} // namespace
+
+DepthPyramid::DepthPyramid(RenderDeviceVk *device) : m_device{device} {
+  ZoneScoped;
+  createPipeline();
+  // Заглушка 1x1, чтобы читателям было что привязать до первого кадра
+  createPyramid({2, 2});
+}
+
+DepthPyramid::~DepthPyramid() {
+  ZoneScoped;
+  destroyPyramid();
+  m_device->getDevice().destroySampler(m_sampler);
+  m_device->getDevice().destroyPipelineLayout(m_pipelineLayout);
+}
+
+bool DepthPyramid::resize(vk::Extent2D depthExtent) {
+  ZoneScoped;
+  if (depthExtent == m_depthExtent) {
+    return false;
+  }
+  // Размер меняется только вместе со swapchain, ожидание здесь не заметно
+  m_device->getDevice().waitIdle();
+  destroyPyramid();
+  createPyramid(depthExtent);
+  return true;
+}
+
+void DepthPyramid::build(vk::CommandBuffer commandBuffer, size_t frameIndex, vk::ImageView depthView) {
+  ZoneScoped;
+  vk::DescriptorImageInfo depthInfo = {
+      .sampler = m_sampler,
+      .imageView = depthView,
+      .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+  };
+  DescriptorWriterVk(*m_descriptorSetLayout, *m_descriptorPool)
+      .writeImage(0, &depthInfo)
+      .overwrite(m_depthDescriptorSets[frameIndex]);
+
+  m_pipeline->bind(commandBuffer);
+  addComputeBarrier(commandBuffer, vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eShaderWrite);
+  vk::Extent2D srcExtent = m_depthExtent;
+  for (uint32_t level = 0; level < m_mipLevels; level++) {
+    const vk::Extent2D dstExtent = getLevelExtent(level);
+    const vk::DescriptorSet descriptorSet =
+        level == 0 ? m_depthDescriptorSets[frameIndex] : m_levelDescriptorSets[level];
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout, 0, 1, &descriptorSet, 0,
+                                     nullptr);
+    PushConstantData push = {
+        .srcSize = {static_cast<int>(srcExtent.width), static_cast<int>(srcExtent.height)},
+        .dstSize = {static_cast<int>(dstExtent.width), static_cast<int>(dstExtent.height)},
+    };
+    commandBuffer.pushConstants(m_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstantData),
+                                &push);
+    commandBuffer.dispatch((dstExtent.width + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+                           (dstExtent.height + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+    // После последнего уровня пирамиду читает отсечение следующего кадра
+    addComputeBarrier(commandBuffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    srcExtent = dstExtent;
+  }
+}
+
+void DepthPyramid::createPipeline() {
+  ZoneScoped;
+  m_descriptorSetLayout =
+      DescriptorSetLayoutVk::Builder(m_device)
+          .addBinding(0, vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eCompute)
+          .addBinding(1, vk::DescriptorType::eStorageImage, vk::ShaderStageFlagBits::eCompute)
+          .build();
+
+  vk::PushConstantRange pushConstantRange = {
+      .stageFlags = vk::ShaderStageFlagBits::eCompute,
+      .offset = 0,
+      .size = sizeof(PushConstantData),
+  };
+  vk::DescriptorSetLayout descriptorSetLayout = m_descriptorSetLayout->getDescriptorSetLayout();
+  vk::PipelineLayoutCreateInfo pipelineLayoutInfo = {
+      .setLayoutCount = 1,
+      .pSetLayouts = &descriptorSetLayout,
+      .pushConstantRangeCount = 1,
+      .pPushConstantRanges = &pushConstantRange,
+  };
+  m_pipelineLayout = m_device->getDevice().createPipelineLayout(pipelineLayoutInfo);
+  m_pipeline = std::make_unique<ComputePipelineVk>(m_device, "depth_pyramid", m_pipelineLayout);
+
+  // Шейдеры читают только texelFetch, фильтрация не нужна
+  vk::SamplerCreateInfo samplerInfo = {
+      .magFilter = vk::Filter::eNearest,
+      .minFilter = vk::Filter::eNearest,
+      .mipmapMode = vk::SamplerMipmapMode::eNearest,
+      .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+      .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+      .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+      .minLod = 0.0f,
+      .maxLod = VK_LOD_CLAMP_NONE,
+  };
+  m_sampler = m_device->getDevice().createSampler(samplerInfo);
+}
+
+void DepthPyramid::createPyramid(vk::Extent2D depthExtent) {
+  ZoneScoped;
+  m_depthExtent = depthExtent;
+  m_mipLevels = 1;
+  while (m_mipLevels < MAX_MIP_LEVELS) {
+    const vk::Extent2D extent = getLevelExtent(m_mipLevels - 1);
+    if (extent.width == 1 && extent.height == 1) {
+      break;
+    }
+    m_mipLevels++;
+  }
+
+  const vk::Extent2D extent = getLevelExtent(0);
+  vk::ImageCreateInfo imageInfo = {
+      .imageType = vk::ImageType::e2D,
+      .format = vk::Format::eR32Sfloat,
+      .extent = {.width = extent.width, .height = extent.height, .depth = 1},
+      .mipLevels = m_mipLevels,
+      .arrayLayers = 1,
+      .samples = vk::SampleCountFlagBits::e1,
+      .tiling = vk::ImageTiling::eOptimal,
+      .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eStorage |
+               vk::ImageUsageFlagBits::eTransferDst,
+      .sharingMode = vk::SharingMode::eExclusive,
+      .initialLayout = vk::ImageLayout::eUndefined,
+  };
+  m_device->createImageWithInfo(imageInfo, VMA_MEMORY_USAGE_AUTO, m_image, m_imageAllocation);
+
+  auto createView = [&](uint32_t baseLevel, uint32_t levelCount) {
+    vk::ImageViewCreateInfo viewInfo = {.image = m_image,
+                                        .viewType = vk::ImageViewType::e2D,
+                                        .format = vk::Format::eR32Sfloat,
+                                        .subresourceRange = {.aspectMask = vk::ImageAspectFlagBits::eColor,
+                                                             .baseMipLevel = baseLevel,
+                                                             .levelCount = levelCount,
+                                                             .baseArrayLayer = 0,
+                                                             .layerCount = 1}};
+    return m_device->getDevice().createImageView(viewInfo);
+  };
+  m_imageView = createView(0, m_mipLevels);
+  m_levelViews.resize(m_mipLevels);
+  for (uint32_t level = 0; level < m_mipLevels; level++) {
+    m_levelViews[level] = createView(level, 1);
+  }
+
+  // Пирамида всё время живёт в eGeneral: в неё пишут и из неё читают вычислительные шейдеры.
+  // Содержимое заглушки - дальняя плоскость, так что до первого построения ничего не скрыто
+  vk::CommandBuffer commandBuffer = m_device->beginSingleTimeCommands();
+  vk::ImageMemoryBarrier barrier = {
+      .srcAccessMask = vk::AccessFlagBits::eNone,
+      .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
+      .oldLayout = vk::ImageLayout::eUndefined,
+      .newLayout = vk::ImageLayout::eGeneral,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = m_image,
+      .subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, m_mipLevels, 0, 1},
+  };
+  commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {},
+                                nullptr, nullptr, barrier);
+  vk::ClearColorValue farDepth(std::array<float, 4>{1.0f, 1.0f, 1.0f, 1.0f});
+  vk::ImageSubresourceRange range = {vk::ImageAspectFlagBits::eColor, 0, m_mipLevels, 0, 1};
+  commandBuffer.clearColorImage(m_image, vk::ImageLayout::eGeneral, farDepth, range);
+  m_device->endSingleTimeCommands(commandBuffer);
+
+  const uint32_t setsCount = SwapChainVk::MAX_FRAMES_IN_FLIGHT + m_mipLevels;
+  m_descriptorPool = DescriptorPoolVk::Builder(m_device)
+                         .setMaxSets(setsCount)
+                         .addPoolSize(vk::DescriptorType::eCombinedImageSampler, setsCount)
+                         .addPoolSize(vk::DescriptorType::eStorageImage, setsCount)
+                         .build();
+  vk::DescriptorImageInfo level0Info = {.imageView = m_levelViews[0], .imageLayout = vk::ImageLayout::eGeneral};
+  for (auto &descriptorSet : m_depthDescriptorSets) {
+    // Буфер глубины подставляется перед каждым построением
+    vk::DescriptorImageInfo placeholderInfo = {
+        .sampler = m_sampler,
+        .imageView = m_levelViews[0],
+        .imageLayout = vk::ImageLayout::eGeneral,
+    };
+    DescriptorWriterVk(*m_descriptorSetLayout, *m_descriptorPool)
+        .writeImage(0, &placeholderInfo)
+        .writeImage(1, &level0Info)
+        .build(descriptorSet);
+  }
+  m_levelDescriptorSets.assign(m_mipLevels, VK_NULL_HANDLE);
+  for (uint32_t level = 1; level < m_mipLevels; level++) {
+    vk::DescriptorImageInfo srcInfo = {
+        .sampler = m_sampler,
+        .imageView = m_levelViews[level - 1],
+        .imageLayout = vk::ImageLayout::eGeneral,
+    };
+    vk::DescriptorImageInfo dstInfo = {.imageView = m_levelViews[level], .imageLayout = vk::ImageLayout::eGeneral};
+    DescriptorWriterVk(*m_descriptorSetLayout, *m_descriptorPool)
+        .writeImage(0, &srcInfo)
+        .writeImage(1, &dstInfo)
+        .build(m_levelDescriptorSets[level]);
+  }
+}
+
+void DepthPyramid::destroyPyramid() {
+  ZoneScoped;
+  m_descriptorPool.reset();
+  m_levelDescriptorSets.clear();
+  for (const auto view : m_levelViews) {
+    m_device->getDevice().destroyImageView(view);
+  }
+  m_levelViews.clear();
+  m_device->getDevice().destroyImageView(m_imageView);
+  vmaDestroyImage(m_device->getAllocator(), static_cast<VkImage>(m_image), m_imageAllocation);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../core/NonCopyable.hpp"
+#include "backend/ComputePipelineVk.hpp"
+#include "backend/DescriptorsVk.hpp"
+#include "backend/SwapChainVk.hpp"
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+// Иерархический буфер глубины (Hi-Z): уровень 0 вдвое меньше буфера глубины кадра, каждый следующий вдвое меньше
+// предыдущего, тексель хранит самую дальнюю глубину своего квадрата. Тексель (x, y) уровня L покрывает пиксели
+// [x * 2^(L+1), (x + 1) * 2^(L+1)) буфера глубины целиком, без потерь на нечётных краях.
+class DepthPyramid : NonCopyable {
+public:
+  static constexpr uint32_t MAX_MIP_LEVELS = 16;
+
+  DepthPyramid(RenderDeviceVk *device);
+  ~DepthPyramid();
+
+  // До записи кадра: пересоздаёт пирамиду под новый размер буфера глубины, дожидаясь простоя устройства.
+  // Возвращает true, если пирамида пересоздана и её дескрипторы у читателей устарели
+  bool resize(vk::Extent2D depthExtent);
+  // После рендер-пасса: строит пирамиду из буфера глубины кадра в макете eShaderReadOnlyOptimal
+  void build(vk::CommandBuffer commandBuffer, size_t frameIndex, vk::ImageView depthView);
+
+  // Вся цепочка уровней для texelFetch, макет eGeneral
+  inline vk::DescriptorImageInfo getDescriptorInfo() const noexcept {
+    return {.sampler = m_sampler, .imageView = m_imageView, .imageLayout = vk::ImageLayout::eGeneral};
+  }
+  inline vk::Extent2D getDepthExtent() const noexcept { return m_depthExtent; }
+  inline uint32_t getMipLevels() const noexcept { return m_mipLevels; }
+
+private:
+  struct PushConstantData {
+    glm::ivec2 srcSize;
+    glm::ivec2 dstSize;
+  };
+  static constexpr uint32_t WORKGROUP_SIZE = 8;
+
+  void createPipeline();
+  void createPyramid(vk::Extent2D depthExtent);
+  void destroyPyramid();
+  inline vk::Extent2D getLevelExtent(uint32_t level) const noexcept {
+    return {std::max(1u, (m_depthExtent.width + (2u << level) - 1) >> (level + 1)),
+            std::max(1u, (m_depthExtent.height + (2u << level) - 1) >> (level + 1))};
+  }
+
+  RenderDeviceVk *m_device;
+  std::unique_ptr<DescriptorSetLayoutVk> m_descriptorSetLayout;
+  vk::PipelineLayout m_pipelineLayout;
+  std::unique_ptr<ComputePipelineVk> m_pipeline;
+  vk::Sampler m_sampler;
+
+  vk::Extent2D m_depthExtent = {0, 0};
+  uint32_t m_mipLevels = 0;
+  vk::Image m_image = VK_NULL_HANDLE;
+  VmaAllocation m_imageAllocation = VK_NULL_HANDLE;
+  vk::ImageView m_imageView = VK_NULL_HANDLE;
+  std::vector<vk::ImageView> m_levelViews;
+  std::unique_ptr<DescriptorPoolVk> m_descriptorPool;
+  // Уровень 0 читает буфер глубины текущего изображения swapchain, поэтому набор свой на каждый кадр в полёте
+  std::array<vk::DescriptorSet, SwapChainVk::MAX_FRAMES_IN_FLIGHT> m_depthDescriptorSets;
+  // Набор уровня L читает уровень L - 1, для L = 0 не используется
+  std::vector<vk::DescriptorSet> m_levelDescriptorSets;
+};
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "MeshArena.hpp"
 #include "backend/BufferVk.hpp"
 #include "backend/RenderDeviceVk.hpp"
+#include "backend/UploadServiceVk.hpp"
+#include <algorithm>
 #include <memory>
 #include <tracy/Tracy.hpp>
 
@@ -13,9 +16,26 @@ public:
     createVertexBuffers(vertices);
     createIndexBuffer(indices);
   };
+  // Меш в странице арены вместо собственных буферов
+  Mesh(MeshArena *arena, const std::span<T> &vertices, const std::span<uint32_t> &indices)
+      : m_device{nullptr}, m_arena{arena} {
+    ZoneScoped;
+    m_vertexCount = static_cast<uint32_t>(vertices.size());
+    m_indexCount = static_cast<uint32_t>(indices.size());
+    m_arenaRange = m_arena->allocate(std::as_bytes(std::span<const T>(vertices)), indices);
+  };
+  ~Mesh() {
+    if (m_arenaRange) {
+      m_arena->free(std::move(m_arenaRange));
+    }
+  };
 
   inline void bind(vk::CommandBuffer commandBuffer) {
     ZoneScoped;
+    if (m_arenaRange) {
+      m_arena->bind(commandBuffer, m_arenaRange->page);
+      return;
+    }
     vk::Buffer buffers[] = {m_vertexBuffer->getBuffer()};
     vk::DeviceSize offsets[] = {0};
     commandBuffer.bindVertexBuffers(0, 1, buffers, offsets);
@@ -23,54 +43,46 @@ public:
   };
   inline void draw(vk::CommandBuffer commandBuffer) {
     ZoneScoped;
-    commandBuffer.drawIndexed(m_indexCount, 1, 0, 0, 0);
+    commandBuffer.drawIndexed(m_indexCount, 1, getFirstIndex(), getVertexOffset(), 0);
+  };
+  inline void drawRange(vk::CommandBuffer commandBuffer, uint32_t firstIndex, uint32_t indexCount) {
+    ZoneScoped;
+    commandBuffer.drawIndexed(indexCount, 1, getFirstIndex() + firstIndex, getVertexOffset(), 0);
   };
 
   inline uint32_t getVertexCount() const noexcept { return m_vertexCount; }
   inline uint32_t getIndexCount() const noexcept { return m_indexCount; }
+  // Начало меша в буферах, к которым он привязывается; у меша с собственными буферами - ноль
+  inline uint32_t getFirstIndex() const noexcept { return m_arenaRange ? m_arenaRange->firstIndex : 0; }
+  inline int32_t getVertexOffset() const noexcept { return m_arenaRange ? m_arenaRange->vertexOffset : 0; }
+  // nullptr, если у меша собственные буферы
+  inline const MeshArena::Range *getArenaRange() const noexcept { return m_arenaRange.get(); }
+  // Загрузка меша видна графике
+  inline bool isReady() const noexcept {
+    return m_arenaRange ? m_arena->isReady(*m_arenaRange) : m_device->getUploadService().isReady(m_uploadTicket);
+  }
 
 private:
+  // Буферы загружаются через очередь передачи, как и меши арены
   void createVertexBuffers(const std::span<T> &vertices) {
     ZoneScoped;
     m_vertexCount = static_cast<uint32_t>(vertices.size());
-    vk::DeviceSize bufferSize = sizeof(T) * m_vertexCount;
-    uint32_t vertexSize = sizeof(T);
-
-    BufferVk stagingBuffer = {m_device,
-                              vertexSize,
-                              m_vertexCount,
-                              vk::BufferUsageFlagBits::eTransferSrc,
-                              VMA_MEMORY_USAGE_AUTO,
-                              VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT};
-
-    stagingBuffer.writeToBuffer((void *)vertices.data(), bufferSize);
-
     m_vertexBuffer = std::make_unique<BufferVk>(
-        m_device, vertexSize, m_vertexCount,
+        m_device, sizeof(T), m_vertexCount,
         vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_AUTO);
-
-    m_device->copyBuffer(stagingBuffer.getBuffer(), m_vertexBuffer->getBuffer(), bufferSize);
+    m_uploadTicket = m_device->getUploadService().upload(m_vertexBuffer->getBuffer(), 0,
+                                                         std::as_bytes(std::span<const T>(vertices)));
   };
   void createIndexBuffer(const std::span<uint32_t> &indices) {
     ZoneScoped;
     m_indexCount = static_cast<uint32_t>(indices.size());
-    vk::DeviceSize bufferSize = sizeof(uint32_t) * m_indexCount;
-    uint32_t indexSize = sizeof(uint32_t);
-
-    BufferVk stagingBuffer = {m_device,
-                              indexSize,
-                              m_indexCount,
-                              vk::BufferUsageFlagBits::eTransferSrc,
-                              VMA_MEMORY_USAGE_AUTO,
-                              VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT};
-
-    stagingBuffer.writeToBuffer((void *)indices.data(), bufferSize);
-
     m_indexBuffer = std::make_unique<BufferVk>(
-        m_device, indexSize, m_indexCount,
+        m_device, sizeof(uint32_t), m_indexCount,
         vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_AUTO);
-
-    m_device->copyBuffer(stagingBuffer.getBuffer(), m_indexBuffer->getBuffer(), bufferSize);
+    const UploadServiceVk::Ticket ticket = m_device->getUploadService().upload(
+        m_indexBuffer->getBuffer(), 0, std::as_bytes(std::span<const uint32_t>(indices)));
+    // Между загрузками вершин и индексов пачка могла уйти: готовность определяет более поздняя
+    m_uploadTicket = std::max(m_uploadTicket, ticket);
   };
 
 private:
@@ -80,4 +92,8 @@ private:
 
   std::unique_ptr<BufferVk> m_indexBuffer;
   uint32_t m_indexCount;
+  UploadServiceVk::Ticket m_uploadTicket = 0;
+
+  MeshArena *m_arena = nullptr;
+  std::unique_ptr<MeshArena::Range> m_arenaRange;
 };
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include "MeshArena.hpp"
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <tracy/Tracy.hpp>
+
+MeshArena::MeshArena(RenderDeviceVk *device, uint32_t vertexSize, uint32_t pageVertexCapacity,
+                     uint32_t pageIndexCapacity)
+    : m_device{device}, m_vertexSize{vertexSize}, m_pageVertexCapacity{pageVertexCapacity},
+      m_pageIndexCapacity{pageIndexCapacity} {
+  ZoneScoped;
+  addPage(m_pageVertexCapacity, m_pageIndexCapacity);
+}
+
+MeshArena::~MeshArena() {
+  ZoneScoped;
+  assert(m_ranges.empty() && "Meshes must be destroyed before their arena");
+  for (auto &page : m_pages) {
+    destroyPage(page);
+  }
+}
+
+std::unique_ptr<MeshArena::Range> MeshArena::allocate(std::span<const std::byte> vertices,
+                                                      std::span<const uint32_t> indices) {
+  ZoneScoped;
+  assert(!vertices.empty() && !indices.empty() && vertices.size() % m_vertexSize == 0);
+  auto range = std::make_unique<Range>();
+  range->vertexCount = static_cast<uint32_t>(vertices.size() / m_vertexSize);
+  range->indexCount = static_cast<uint32_t>(indices.size());
+  std::lock_guard<std::mutex> lock(m_mutex);
+  releaseUploadedFrees();
+  if (!tryPlace(*range, m_pages.size(), 0)) {
+    addPage(std::max(m_pageVertexCapacity, range->vertexCount), std::max(m_pageIndexCapacity, range->indexCount));
+    if (!tryPlace(*range, m_pages.size(), 0)) {
+      throw std::runtime_error("failed to allocate mesh in arena!");
+    }
+  }
+  // Обе копии попадают в одну пачку очереди передачи; билет берётся до того, как compact увидит диапазон
+  const vk::DeviceSize vertexOffset = static_cast<vk::DeviceSize>(range->vertexOffset) * m_vertexSize;
+  const vk::DeviceSize indexOffset = static_cast<vk::DeviceSize>(range->firstIndex) * sizeof(uint32_t);
+  UploadServiceVk &uploadService = m_device->getUploadService();
+  uploadService.upload(m_pages[range->page].vertexBuffer->getBuffer(), vertexOffset, vertices);
+  range->uploadTicket =
+      uploadService.upload(m_pages[range->page].indexBuffer->getBuffer(), indexOffset, std::as_bytes(indices));
+  m_ranges.insert(range.get());
+  return range;
+}
+
+void MeshArena::free(std::unique_ptr<Range> range) {
+  ZoneScoped;
+  if (!range) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_ranges.erase(range.get());
+  // Новый меш на этом месте мог бы быть перезаписан ещё идущей загрузкой
+  if (!m_device->getUploadService().isComplete(range->uploadTicket)) {
+    m_pendingFrees.push_back(std::move(range));
+    return;
+  }
+  release(*range);
+}
+
+void MeshArena::bind(vk::CommandBuffer commandBuffer, uint32_t page) {
+  vk::Buffer buffers[] = {m_pages[page].vertexBuffer->getBuffer()};
+  vk::DeviceSize offsets[] = {0};
+  commandBuffer.bindVertexBuffers(0, 1, buffers, offsets);
+  commandBuffer.bindIndexBuffer(m_pages[page].indexBuffer->getBuffer(), 0, vk::IndexType::eUint32);
+}
+
+size_t MeshArena::compact(vk::DeviceSize maxBytes) {
+  ZoneScoped;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  releaseUploadedFrees();
+  // Сначала меши дальних страниц и концов страниц: их место освобождает хвост арены.
+  // Бюджет кончается за несколько мешей, поэтому вместо сортировки всех - куча с дальним мешем наверху
+  m_compactionOrder.assign(m_ranges.begin(), m_ranges.end());
+  auto isNearer = [](const Range *a, const Range *b) {
+    return a->page != b->page ? a->page < b->page : a->vertexOffset < b->vertexOffset;
+  };
+  std::make_heap(m_compactionOrder.begin(), m_compactionOrder.end(), isNearer);
+  auto heapEnd = m_compactionOrder.end();
+  m_moves.clear();
+  vk::DeviceSize movedBytes = 0;
+  while (heapEnd != m_compactionOrder.begin() && movedBytes < maxBytes) {
+    std::pop_heap(m_compactionOrder.begin(), heapEnd, isNearer);
+    --heapEnd;
+    Range *range = *heapEnd;
+    // Не захваченный графикой меш ещё пишет очередь передачи
+    if (!isReady(*range)) {
+      continue;
+    }
+    Range target = *range;
+    if (!tryPlace(target, range->page + 1, VMA_VIRTUAL_ALLOCATION_CREATE_STRATEGY_MIN_OFFSET_BIT)) {
+      continue;
+    }
+    // Старое место ещё занято, так что новое с ним не пересекается, но может оказаться не ближе
+    const bool isCloser = target.page < range->page || (target.vertexOffset <= range->vertexOffset &&
+                                                        target.firstIndex <= range->firstIndex &&
+                                                        (target.vertexOffset < range->vertexOffset ||
+                                                         target.firstIndex < range->firstIndex));
+    if (!isCloser) {
+      release(target);
+      continue;
+    }
+    m_moves.push_back({range, target});
+    movedBytes += static_cast<vk::DeviceSize>(range->vertexCount) * m_vertexSize +
+                  static_cast<vk::DeviceSize>(range->indexCount) * sizeof(uint32_t);
+  }
+  if (!m_moves.empty()) {
+    vk::CommandBuffer commandBuffer = m_device->beginSingleTimeCommands();
+    for (const Move &move : m_moves) {
+      const Range &source = *move.range;
+      vk::BufferCopy vertexRegion = {
+          .srcOffset = static_cast<vk::DeviceSize>(source.vertexOffset) * m_vertexSize,
+          .dstOffset = static_cast<vk::DeviceSize>(move.target.vertexOffset) * m_vertexSize,
+          .size = static_cast<vk::DeviceSize>(source.vertexCount) * m_vertexSize,
+      };
+      commandBuffer.copyBuffer(m_pages[source.page].vertexBuffer->getBuffer(),
+                               m_pages[move.target.page].vertexBuffer->getBuffer(), 1, &vertexRegion);
+      vk::BufferCopy indexRegion = {
+          .srcOffset = static_cast<vk::DeviceSize>(source.firstIndex) * sizeof(uint32_t),
+          .dstOffset = static_cast<vk::DeviceSize>(move.target.firstIndex) * sizeof(uint32_t),
+          .size = static_cast<vk::DeviceSize>(source.indexCount) * sizeof(uint32_t),
+      };
+      commandBuffer.copyBuffer(m_pages[source.page].indexBuffer->getBuffer(),
+                               m_pages[move.target.page].indexBuffer->getBuffer(), 1, &indexRegion);
+    }
+    // Очередь простаивает после отправки: ни копирование, ни прошлые кадры старые места больше не читают
+    m_device->endSingleTimeCommands(commandBuffer);
+    for (const Move &move : m_moves) {
+      release(*move.range);
+      *move.range = move.target;
+    }
+    m_movedMeshes += m_moves.size();
+  }
+
+  // Первая страница остаётся всегда, чтобы не пересоздавать её на следующем же меше
+  while (m_pages.size() > 1 && vmaIsVirtualBlockEmpty(m_pages.back().vertexBlock)) {
+    destroyPage(m_pages.back());
+    m_pages.pop_back();
+  }
+  return m_moves.size();
+}
+
+MeshArena::Stats MeshArena::getStats() {
+  ZoneScoped;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  releaseUploadedFrees();
+  Stats stats = {.pagesCount = m_pages.size(), .meshesCount = m_ranges.size(), .movedMeshes = m_movedMeshes};
+  vk::DeviceSize freeBytes = 0;
+  auto addBlock = [&](VmaVirtualBlock block, vk::DeviceSize elementSize) {
+    VmaDetailedStatistics blockStats = {};
+    vmaCalculateVirtualBlockStatistics(block, &blockStats);
+    const vk::DeviceSize blockFree = blockStats.statistics.blockBytes - blockStats.statistics.allocationBytes;
+    stats.capacityBytes += blockStats.statistics.blockBytes * elementSize;
+    stats.usedBytes += blockStats.statistics.allocationBytes * elementSize;
+    freeBytes += blockFree * elementSize;
+    stats.fragmentedBytes += (blockFree - blockStats.unusedRangeSizeMax) * elementSize;
+  };
+  for (const Page &page : m_pages) {
+    addBlock(page.vertexBlock, m_vertexSize);
+    addBlock(page.indexBlock, sizeof(uint32_t));
+  }
+  stats.fragmentation =
+      freeBytes > 0 ? static_cast<float>(stats.fragmentedBytes) / static_cast<float>(freeBytes) : 0.0f;
+  return stats;
+}
+
+void MeshArena::addPage(uint32_t vertexCapacity, uint32_t indexCapacity) {
+  ZoneScoped;
+  Page page = {};
+  // Страницы копируются друг в друга при compact
+  page.vertexBuffer = std::make_unique<BufferVk>(m_device, m_vertexSize, vertexCapacity,
+                                                 vk::BufferUsageFlagBits::eVertexBuffer |
+                                                     vk::BufferUsageFlagBits::eTransferDst |
+                                                     vk::BufferUsageFlagBits::eTransferSrc,
+                                                 VMA_MEMORY_USAGE_AUTO);
+  page.indexBuffer = std::make_unique<BufferVk>(m_device, sizeof(uint32_t), indexCapacity,
+                                                vk::BufferUsageFlagBits::eIndexBuffer |
+                                                    vk::BufferUsageFlagBits::eTransferDst |
+                                                    vk::BufferUsageFlagBits::eTransferSrc,
+                                                VMA_MEMORY_USAGE_AUTO);
+  // Размеры виртуальных блоков - в вершинах и индексах, а не в байтах
+  VmaVirtualBlockCreateInfo vertexBlockInfo = {.size = vertexCapacity};
+  VmaVirtualBlockCreateInfo indexBlockInfo = {.size = indexCapacity};
+  if (vmaCreateVirtualBlock(&vertexBlockInfo, &page.vertexBlock) != VK_SUCCESS ||
+      vmaCreateVirtualBlock(&indexBlockInfo, &page.indexBlock) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create mesh arena page!");
+  }
+  m_pages.push_back(std::move(page));
+}
+
+void MeshArena::destroyPage(Page &page) {
+  vmaClearVirtualBlock(page.vertexBlock);
+  vmaClearVirtualBlock(page.indexBlock);
+  vmaDestroyVirtualBlock(page.vertexBlock);
+  vmaDestroyVirtualBlock(page.indexBlock);
+  page.vertexBuffer.reset();
+  page.indexBuffer.reset();
+}
+
+bool MeshArena::tryPlace(Range &range, size_t pagesCount, VmaVirtualAllocationCreateFlags flags) {
+  for (size_t i = 0; i < pagesCount; i++) {
+    Page &page = m_pages[i];
+    VmaVirtualAllocationCreateInfo vertexInfo = {.size = range.vertexCount, .alignment = 1, .flags = flags};
+    VmaVirtualAllocationCreateInfo indexInfo = {.size = range.indexCount, .alignment = 1, .flags = flags};
+    vk::DeviceSize vertexOffset;
+    vk::DeviceSize firstIndex;
+    if (vmaVirtualAllocate(page.vertexBlock, &vertexInfo, &range.vertexAllocation, &vertexOffset) != VK_SUCCESS) {
+      continue;
+    }
+    if (vmaVirtualAllocate(page.indexBlock, &indexInfo, &range.indexAllocation, &firstIndex) != VK_SUCCESS) {
+      vmaVirtualFree(page.vertexBlock, range.vertexAllocation);
+      continue;
+    }
+    range.page = static_cast<uint32_t>(i);
+    range.vertexOffset = static_cast<int32_t>(vertexOffset);
+    range.firstIndex = static_cast<uint32_t>(firstIndex);
+    return true;
+  }
+  return false;
+}
+
+void MeshArena::release(const Range &range) {
+  vmaVirtualFree(m_pages[range.page].vertexBlock, range.vertexAllocation);
+  vmaVirtualFree(m_pages[range.page].indexBlock, range.indexAllocation);
+}
+
+void MeshArena::releaseUploadedFrees() {
+  if (m_pendingFrees.empty()) {
+    return;
+  }
+  std::erase_if(m_pendingFrees, [this](const std::unique_ptr<Range> &range) {
+    if (!m_device->getUploadService().isComplete(range->uploadTicket)) {
+      return false;
+    }
+    release(*range);
+    return true;
+  });
+}
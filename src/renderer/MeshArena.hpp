@@ -0,0 +1,96 @@
+#pragma once
+
+#include "../core/NonCopyable.hpp"
+#include "backend/BufferVk.hpp"
+#include "backend/RenderDeviceVk.hpp"
+#include "backend/UploadServiceVk.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_set>
+#include <vector>
+
+// Общие буферы вершин и индексов для мешей одного формата вершин. Меш занимает в странице арены по диапазону
+// вершин и индексов, выделенному виртуальными блоками VMA, и все меши страницы рисуются без перепривязки буферов.
+// Новая страница заводится, только когда меш не помещается ни в одну из существующих.
+// Меши загружаются через очередь передачи: рисовать меш можно, когда isReady.
+class MeshArena : NonCopyable {
+public:
+  // Место меша в арене; смещения в вершинах и индексах меняет только compact
+  struct Range {
+    uint32_t page;
+    VmaVirtualAllocation vertexAllocation;
+    VmaVirtualAllocation indexAllocation;
+    int32_t vertexOffset;
+    uint32_t firstIndex;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    UploadServiceVk::Ticket uploadTicket;
+  };
+  struct Stats {
+    size_t pagesCount;
+    size_t meshesCount;
+    vk::DeviceSize capacityBytes;
+    vk::DeviceSize usedBytes;
+    // Свободные байты вне наибольшего свободного диапазона своей страницы
+    vk::DeviceSize fragmentedBytes;
+    // Доля fragmentedBytes среди свободных: 0 - свободное место каждой страницы лежит одним куском
+    float fragmentation;
+    // Меши, перенесённые compact за всё время
+    size_t movedMeshes;
+  };
+
+  // Ёмкости страницы - в вершинах и индексах; меш крупнее страницы получает свою страницу по размеру
+  MeshArena(RenderDeviceVk *device, uint32_t vertexSize, uint32_t pageVertexCapacity, uint32_t pageIndexCapacity);
+  ~MeshArena();
+
+  // Выделяет место и ставит копирование меша в очередь передачи, не дожидаясь его. Адрес Range стабилен до free
+  std::unique_ptr<Range> allocate(std::span<const std::byte> vertices, std::span<const uint32_t> indices);
+  // Можно звать из любого потока; графика уже не должна читать диапазон. Место ещё не загруженного меша
+  // освобождается после завершения загрузки
+  void free(std::unique_ptr<Range> range);
+  inline bool isReady(const Range &range) const noexcept {
+    return m_device->getUploadService().isReady(range.uploadTicket);
+  }
+  void bind(vk::CommandBuffer commandBuffer, uint32_t page);
+  // Переносит меши с конца страниц в свободные места ближе к началу арены, копируя не больше maxBytes,
+  // и освобождает опустевшие последние страницы. Ждёт простоя очереди графики, поэтому зовётся вне записи кадра.
+  // Возвращает число перенесённых мешей: смещения, уже записанные в буферы GPU, после этого устарели
+  size_t compact(vk::DeviceSize maxBytes);
+  Stats getStats();
+
+private:
+  struct Page {
+    std::unique_ptr<BufferVk> vertexBuffer;
+    std::unique_ptr<BufferVk> indexBuffer;
+    VmaVirtualBlock vertexBlock;
+    VmaVirtualBlock indexBlock;
+  };
+  struct Move {
+    Range *range;
+    Range target;
+  };
+
+  void addPage(uint32_t vertexCapacity, uint32_t indexCapacity);
+  void destroyPage(Page &page);
+  // Ищет место в страницах [0, pagesCount); заполняет page, аллокации и смещения range
+  bool tryPlace(Range &range, size_t pagesCount, VmaVirtualAllocationCreateFlags flags);
+  void release(const Range &range);
+  void releaseUploadedFrees();
+
+  RenderDeviceVk *m_device;
+  uint32_t m_vertexSize;
+  uint32_t m_pageVertexCapacity;
+  uint32_t m_pageIndexCapacity;
+  // Меши освобождаются из потоков выгрузки чанков
+  std::mutex m_mutex;
+  std::vector<Page> m_pages;
+  std::unordered_set<Range *> m_ranges;
+  // Освобождённые меши, в которые ещё пишет очередь передачи
+  std::vector<std::unique_ptr<Range>> m_pendingFrees;
+  std::vector<Range *> m_compactionOrder;
+  std::vector<Move> m_moves;
+  size_t m_movedMeshes = 0;
+};
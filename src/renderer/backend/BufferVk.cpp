@@ -47,6 +47,24 @@ void BufferVk::writeToBuffer(void *data, vk::DeviceSize size, vk::DeviceSize off
                             size == VK_WHOLE_SIZE ? m_bufferSize : size);
 }
 
+/**
+ * Copies the specified range of the mapped buffer to host memory. Default
+ * value reads whole buffer range
+ *
+ * @note The buffer must be created with host access, memory is invalidated
+ * automatically
+ *
+ * @param data Pointer to the destination memory
+ * @param size (Optional) Size of the data to copy. Pass VK_WHOLE_SIZE to read
+ * the complete buffer range.
+ * @param offset (Optional) Byte offset from beginning of mapped region
+ *
+ */
+void BufferVk::readFromBuffer(void *data, vk::DeviceSize size, vk::DeviceSize offset) {
+  vmaCopyAllocationToMemory(m_device->getAllocator(), m_allocation, offset, data,
+                            size == VK_WHOLE_SIZE ? m_bufferSize : size);
+}
+
 /**
  * Flush a memory range of the buffer to make it visible to the device
  *
@@ -13,6 +13,7 @@ public:
   BufferVk &operator=(const BufferVk &) = delete;
 
   void writeToBuffer(void *data, vk::DeviceSize size = VK_WHOLE_SIZE, vk::DeviceSize offset = 0);
+  void readFromBuffer(void *data, vk::DeviceSize size = VK_WHOLE_SIZE, vk::DeviceSize offset = 0);
   vk::Result flush(vk::DeviceSize size = VK_WHOLE_SIZE, vk::DeviceSize offset = 0);
   vk::DescriptorBufferInfo descriptorInfo(vk::DeviceSize size = VK_WHOLE_SIZE, vk::DeviceSize offset = 0);
   void invalidate(vk::DeviceSize size = VK_WHOLE_SIZE, vk::DeviceSize offset = 0);
@@ -29,6 +30,8 @@ public:
   inline vk::BufferUsageFlags getUsageFlags() const noexcept { return m_usageFlags; }
   inline VmaMemoryUsage getMemoryPropertyFlags() const noexcept { return m_memoryUsage; }
   inline vk::DeviceSize getBufferSize() const noexcept { return m_bufferSize; }
+  // Постоянное отображение; nullptr, если буфер создан без VMA_ALLOCATION_CREATE_MAPPED_BIT
+  inline void *getMappedData() const noexcept { return m_allocationInfo.pMappedData; }
 
 private:
   static vk::DeviceSize getAlignment(vk::DeviceSize instanceSize, vk::DeviceSize minOffsetAlignment);
@@ -0,0 +1,32 @@
+#include "ComputePipelineVk.hpp"
+#include "../../assets/Utils.hpp"
+#include <format>
+#include <stdexcept>
+
+ComputePipelineVk::ComputePipelineVk(RenderDeviceVk *device, std::string_view compName,
+                                     vk::PipelineLayout pipelineLayout)
+    : m_device(device) {
+  m_compShaderModule = std::make_unique<ShaderModuleVk>(
+      device, (getShadersPath() / std::format("{}.comp.spv", compName)).string(), vk::ShaderStageFlagBits::eCompute);
+
+  vk::ComputePipelineCreateInfo pipelineInfo = {
+      .stage = m_compShaderModule->getShaderStageInfo(),
+      .layout = pipelineLayout,
+      .basePipelineHandle = VK_NULL_HANDLE,
+      .basePipelineIndex = -1,
+  };
+
+  auto result = m_device->getDevice().createComputePipeline(nullptr, pipelineInfo);
+
+  if (result.result != vk::Result::eSuccess) {
+    throw std::runtime_error("failed to create compute pipeline!");
+  }
+
+  m_computePipeline = result.value;
+}
+
+ComputePipelineVk::~ComputePipelineVk() { m_device->getDevice().destroyPipeline(m_computePipeline); }
+
+void ComputePipelineVk::bind(vk::CommandBuffer commandBuffer) {
+  commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_computePipeline);
+}
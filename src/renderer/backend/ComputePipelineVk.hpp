@@ -0,0 +1,20 @@
+#pragma once
+
+#include "RenderDeviceVk.hpp"
+#include "ShaderModuleVk.hpp"
+#include <memory>
+#include <string_view>
+
+class ComputePipelineVk : NonCopyable {
+public:
+  ComputePipelineVk(RenderDeviceVk *device, std::string_view compName, vk::PipelineLayout pipelineLayout);
+
+  ~ComputePipelineVk();
+
+  void bind(vk::CommandBuffer commandBuffer);
+
+private:
+  RenderDeviceVk *m_device;
+  vk::Pipeline m_computePipeline;
+  std::unique_ptr<ShaderModuleVk> m_compShaderModule;
+};
@@ -2,6 +2,7 @@
 #define VMA_IMPLEMENTATION
 #include "../../core/LogMacros.hpp"
 #include "RenderDeviceVk.hpp"
+#include "UploadServiceVk.hpp"
 #include <map>
 #include <set>
 #include <string>
@@ -43,9 +44,14 @@ RenderDeviceVk::RenderDeviceVk(Window *window) : m_window{window} {
   createLogicalDevice();
   createAllocator();
   createCommandPool();
+  QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
+  m_uploadService =
+      std::make_unique<UploadServiceVk>(this, indices.transferFamily.value(), indices.graphicsFamily.value());
 }
 
 RenderDeviceVk::~RenderDeviceVk() {
+  // Промежуточные буферы загрузок освобождаются через аллокатор
+  m_uploadService.reset();
   vmaDestroyAllocator(m_allocator);
   m_device.destroyCommandPool(m_commandPool);
   m_device.destroy();
@@ -143,31 +149,20 @@ void RenderDeviceVk::createLogicalDevice() {
     queueCreateInfos.push_back({.queueFamilyIndex = queueFamily, .queueCount = 1, .pQueuePriorities = &queuePriority});
   }
 
-  vk::PhysicalDeviceHostQueryResetFeaturesEXT resetFeatures = {.hostQueryReset = VK_TRUE};
-
-  vk::PhysicalDeviceShaderSubgroupExtendedTypesFeaturesKHR shaderSubgroupFeatures = {
-      .pNext = &resetFeatures,
-      .shaderSubgroupExtendedTypes = VK_TRUE,
-  };
-
-  vk::PhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures = {
-      .pNext = &shaderSubgroupFeatures,
-      .shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
-      .runtimeDescriptorArray = VK_TRUE,
-  };
-
-  vk::PhysicalDeviceShaderAtomicInt64FeaturesKHR atomicInt64Features = {
-      .pNext = &descriptorIndexingFeatures,
+  // Расширения, вошедшие в ядро 1.2, включаются одной структурой: вместе с ней их отдельные структуры запрещены
+  vk::PhysicalDeviceVulkan12Features vulkan12Features = {
+      .drawIndirectCount = VK_TRUE,
       .shaderBufferInt64Atomics = VK_TRUE,
-  };
-
-  vk::PhysicalDeviceFloat16Int8FeaturesKHR float16Int8Features = {
-      .pNext = &atomicInt64Features,
       .shaderFloat16 = VK_TRUE,
+      .shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+      .runtimeDescriptorArray = VK_TRUE,
+      .shaderSubgroupExtendedTypes = VK_TRUE,
+      .hostQueryReset = VK_TRUE,
+      .timelineSemaphore = VK_TRUE,
   };
 
   vk::PhysicalDeviceFeatures2 deviceFeatures = {
-      .pNext = &float16Int8Features,
+      .pNext = &vulkan12Features,
       .features =
           {
               .independentBlend = VK_TRUE,
@@ -349,30 +344,37 @@ QueueFamilyIndices RenderDeviceVk::findQueueFamilies(const vk::PhysicalDevice de
   auto queueFamilies = device.getQueueFamilyProperties();
 
   vk::QueueFlags transferQueueFlags = vk::QueueFlagBits::eTransfer;
+  // Лучше всего семейство только для передачи: его копирования идут параллельно графике и вычислениям
+  auto getTransferScore = [](vk::QueueFlags flags) {
+    return (flags & vk::QueueFlagBits::eGraphics ? 0 : 2) + (flags & vk::QueueFlagBits::eCompute ? 0 : 1);
+  };
+  int transferScore = -1;
 
   int i = 0;
   for (const auto &queueFamily : queueFamilies) {
-    if (queueFamily.queueCount > 0 && queueFamily.queueFlags & vk::QueueFlagBits::eGraphics) {
+    if (!indices.graphicsFamily && queueFamily.queueCount > 0 &&
+        queueFamily.queueFlags & vk::QueueFlagBits::eGraphics) {
       indices.graphicsFamily = i;
       indices.graphicsFamilySupportsTimeStamps = queueFamily.timestampValidBits > 0;
     }
 
-    if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & transferQueueFlags) == transferQueueFlags) {
+    // Графическое и вычислительное семейства тоже умеют передачу, даже без флага
+    const vk::QueueFlags flags = queueFamily.queueFlags;
+    const bool canTransfer = (flags & transferQueueFlags) == transferQueueFlags ||
+                             (flags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute));
+    if (queueFamily.queueCount > 0 && canTransfer && getTransferScore(flags) > transferScore) {
       indices.transferFamily = i;
       indices.transferFamilySupportsTimeStamps = queueFamily.timestampValidBits > 0;
+      transferScore = getTransferScore(flags);
     }
 
     VkBool32 presentSupport = device.getSurfaceSupportKHR(static_cast<uint32_t>(i), m_surface);
 
-    if (queueFamily.queueCount > 0 && presentSupport) {
+    if (!indices.presentFamily && queueFamily.queueCount > 0 && presentSupport) {
       indices.presentFamily = i;
       indices.presentFamilySupportsTimeStamps = queueFamily.timestampValidBits > 0;
     }
 
-    if (indices.IsComplete()) {
-      break;
-    }
-
     i++;
   }
 
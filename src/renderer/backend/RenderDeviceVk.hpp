@@ -2,6 +2,7 @@
 
 #include "../../core/NonCopyable.hpp"
 #include "../../core/Window.hpp"
+#include <memory>
 #include <vector>
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan_handles.hpp>
@@ -25,6 +26,8 @@ struct QueueFamilyIndices {
   bool IsComplete() { return graphicsFamily.has_value() && transferFamily.has_value() && presentFamily.has_value(); }
 };
 
+class UploadServiceVk;
+
 class RenderDeviceVk : NonCopyable {
 public:
   RenderDeviceVk(Window *window);
@@ -43,6 +46,8 @@ public:
   inline VmaAllocator &getAllocator() noexcept { return m_allocator; };
   inline vk::CommandPool &getCommandPool() noexcept { return m_commandPool; };
   inline vk::Instance &getInstance() noexcept { return m_instance; };
+  // Асинхронные загрузки в буферы через очередь передачи
+  inline UploadServiceVk &getUploadService() noexcept { return *m_uploadService; };
 
   void createImageWithInfo(const vk::ImageCreateInfo &imageInfo, VmaMemoryUsage memoryUsage, vk::Image &image,
                            VmaAllocation &imageAllocation);
@@ -84,6 +89,7 @@ private:
   vk::Queue m_presentQueue;
 
   vk::CommandPool m_commandPool;
+  std::unique_ptr<UploadServiceVk> m_uploadService;
 
   vk::DebugUtilsMessengerEXT m_debugMessenger;
   vk::detail::DispatchLoaderDynamic dldi;
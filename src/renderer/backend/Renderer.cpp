@@ -1,5 +1,6 @@
 #include "Renderer.hpp"
 #include "SwapChainVk.hpp"
+#include "UploadServiceVk.hpp"
 #include <tracy/Tracy.hpp>
 #include <vulkan/vulkan.hpp>
 
@@ -53,6 +54,8 @@ vk::CommandBuffer Renderer::beginFrame() {
   ZoneScoped;
   assert(!m_isFrameStarted && "Can't call beginFrame while already in progress");
 
+  // Загрузки, накопленные с прошлого кадра, уходят в очередь передачи даже без кадра
+  m_device->getUploadService().submit();
   auto result = m_swapChain->acquireNextImage(&m_currentImageIndex);
 
   if (result == vk::Result::eErrorOutOfDateKHR) {
@@ -74,6 +77,7 @@ vk::CommandBuffer Renderer::beginFrame() {
   vk::CommandBufferBeginInfo beginInfo{};
 
   commandBuffer.begin(beginInfo);
+  m_device->getUploadService().acquireCompleted(commandBuffer);
 
   return commandBuffer;
 }
@@ -85,7 +89,9 @@ void Renderer::endFrame() {
   auto commandBuffer = getCurrentCommandBuffer();
   commandBuffer.end();
 
-  auto result = m_swapChain->submitCommandBuffers(&commandBuffer, &m_currentImageIndex);
+  UploadServiceVk &uploadService = m_device->getUploadService();
+  auto result = m_swapChain->submitCommandBuffers(&commandBuffer, &m_currentImageIndex,
+                                                  uploadService.getSemaphore(), uploadService.getAcquiredValue());
 
   if (result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR ||
       m_window->wasWindowResized()) {
@@ -11,6 +11,11 @@ public:
 
   inline float getAspectRatio() const { return m_swapChain->extentAspectRatio(); }
   inline VkRenderPass getSwapChainRenderPass() const { return m_swapChain->getRenderPass(); }
+  inline vk::Extent2D getSwapChainExtent() const { return m_swapChain->getSwapChainExtent(); }
+  inline vk::ImageView getCurrentDepthImageView() const {
+    assert(m_isFrameStarted && "Cannot get depth image when frame not in progress");
+    return m_swapChain->getDepthImageView(m_currentImageIndex);
+  }
   inline size_t getFrameIndex() const {
     assert(m_isFrameStarted && "Cannog get frame index when frame not in progress");
     return m_currentFrameIndex;
@@ -0,0 +1,52 @@
+#include "StagingRingVk.hpp"
+#include <cassert>
+#include <tracy/Tracy.hpp>
+
+StagingRingVk::StagingRingVk(RenderDeviceVk *device, vk::DeviceSize capacity) : m_capacity{capacity} {
+  ZoneScoped;
+  m_buffer = std::make_unique<BufferVk>(
+      device, m_capacity, 1, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_AUTO,
+      VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+  m_data = static_cast<std::byte *>(m_buffer->getMappedData());
+}
+
+std::optional<StagingRingVk::Allocation> StagingRingVk::allocate(vk::DeviceSize size, vk::DeviceSize alignment) {
+  assert(size > 0 && alignment > 0);
+  vk::DeviceSize offset = (m_head + alignment - 1) / alignment * alignment;
+  vk::DeviceSize padding = offset - m_head;
+  // Не помещается до конца буфера: хвост пропускается и занят до выполнения текущей пачки
+  if (offset + size > m_capacity) {
+    offset = 0;
+    padding = m_capacity - m_head;
+  }
+  if (m_usedBytes + padding + size > m_capacity) {
+    return std::nullopt;
+  }
+  m_head = offset + size;
+  m_usedBytes += padding + size;
+  m_openBytes += padding + size;
+  return Allocation{.buffer = m_buffer->getBuffer(), .offset = offset, .data = m_data + offset};
+}
+
+void StagingRingVk::flush(const Allocation &allocation, vk::DeviceSize size) {
+  m_buffer->flush(size, allocation.offset);
+}
+
+void StagingRingVk::close(uint64_t value) {
+  if (m_openBytes == 0) {
+    return;
+  }
+  m_regions.push_back({.value = value, .size = m_openBytes});
+  m_openBytes = 0;
+}
+
+void StagingRingVk::reclaim(uint64_t completedValue) {
+  while (!m_regions.empty() && m_regions.front().value <= completedValue) {
+    m_usedBytes -= m_regions.front().size;
+    m_regions.pop_front();
+  }
+  // Пустое кольцо начинается сначала, чтобы реже пропускать хвост
+  if (m_usedBytes == 0) {
+    m_head = 0;
+  }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../../core/NonCopyable.hpp"
+#include "BufferVk.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+
+// Постоянно отображённый промежуточный буфер, который занимается по кругу. Выделенное до close(value) место
+// возвращает reclaim, когда пачка value выполнена. Синхронизация - на владельце
+class StagingRingVk : NonCopyable {
+public:
+  struct Allocation {
+    vk::Buffer buffer;
+    vk::DeviceSize offset;
+    std::byte *data;
+  };
+
+  StagingRingVk(RenderDeviceVk *device, vk::DeviceSize capacity);
+
+  // size байт подряд со смещением, кратным alignment; nullopt, если столько свободного места подряд нет
+  std::optional<Allocation> allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+  // Делает записанное видимым GPU; для когерентной памяти ничего не делает
+  void flush(const Allocation &allocation, vk::DeviceSize size);
+  // Всё выделенное после прошлого close принадлежит пачке value
+  void close(uint64_t value);
+  // Возвращает место пачек со значениями не больше completedValue
+  void reclaim(uint64_t completedValue);
+
+  inline vk::DeviceSize getCapacity() const noexcept { return m_capacity; }
+  inline vk::DeviceSize getUsedBytes() const noexcept { return m_usedBytes; }
+
+private:
+  struct Region {
+    uint64_t value;
+    vk::DeviceSize size;
+  };
+
+  std::unique_ptr<BufferVk> m_buffer;
+  std::byte *m_data;
+  vk::DeviceSize m_capacity;
+  // Начало свободного места; занятое лежит перед ним по кругу
+  vk::DeviceSize m_head = 0;
+  vk::DeviceSize m_usedBytes = 0;
+  // Байты, выделенные после прошлого close, вместе с пропущенными хвостами
+  vk::DeviceSize m_openBytes = 0;
+  std::deque<Region> m_regions;
+};
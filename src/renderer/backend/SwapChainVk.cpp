@@ -79,7 +79,8 @@ vk::Result SwapChainVk::acquireNextImage(uint32_t *imageIndex) {
   return result;
 }
 
-vk::Result SwapChainVk::submitCommandBuffers(const vk::CommandBuffer *buffers, uint32_t *imageIndex) {
+vk::Result SwapChainVk::submitCommandBuffers(const vk::CommandBuffer *buffers, uint32_t *imageIndex,
+                                             vk::Semaphore timelineSemaphore, uint64_t timelineValue) {
   ZoneScoped;
   if (m_imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
     auto result = m_device->getDevice().waitForFences(1, &m_imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
@@ -89,11 +90,18 @@ vk::Result SwapChainVk::submitCommandBuffers(const vk::CommandBuffer *buffers, u
   }
   m_imagesInFlight[*imageIndex] = m_inFlightFences[m_currentFrame];
 
-  vk::SubmitInfo submitInfo = {};
+  // Значения двоичных семафоров игнорируются, но массив значений общий для всех ожиданий
+  vk::Semaphore waitSemaphores[] = {m_imageAvailableSemaphores[m_currentFrame], timelineSemaphore};
+  vk::PipelineStageFlags waitStages[] = {vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                                         vk::PipelineStageFlagBits::eAllCommands};
+  uint64_t waitValues[] = {0, timelineValue};
+  vk::TimelineSemaphoreSubmitInfo timelineInfo = {
+      .waitSemaphoreValueCount = 2,
+      .pWaitSemaphoreValues = waitValues,
+  };
+  vk::SubmitInfo submitInfo = {.pNext = &timelineInfo};
 
-  vk::Semaphore waitSemaphores[] = {m_imageAvailableSemaphores[m_currentFrame]};
-  vk::PipelineStageFlags waitStages[] = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
-  submitInfo.waitSemaphoreCount = 1;
+  submitInfo.waitSemaphoreCount = 2;
   submitInfo.pWaitSemaphores = waitSemaphores;
   submitInfo.pWaitDstStageMask = waitStages;
 
@@ -208,11 +216,11 @@ void SwapChainVk::createRenderPass() {
   vk::AttachmentDescription depthAttachment = {.format = findDepthFormat(),
                                                .samples = vk::SampleCountFlagBits::e1,
                                                .loadOp = vk::AttachmentLoadOp::eClear,
-                                               .storeOp = vk::AttachmentStoreOp::eDontCare,
+                                               .storeOp = vk::AttachmentStoreOp::eStore,
                                                .stencilLoadOp = vk::AttachmentLoadOp::eDontCare,
                                                .stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
                                                .initialLayout = vk::ImageLayout::eUndefined,
-                                               .finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal};
+                                               .finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal};
 
   vk::AttachmentReference depthAttachmentRef = {.attachment = 1,
                                                 .layout = vk::ImageLayout::eDepthStencilAttachmentOptimal};
@@ -235,23 +243,34 @@ void SwapChainVk::createRenderPass() {
       .pDepthStencilAttachment = &depthAttachmentRef,
   };
 
+  // Глубину прошлого использования этого изображения мог ещё читать вычислительный шейдер
   vk::SubpassDependency dependency = {.srcSubpass = vk::SubpassExternal,
                                       .dstSubpass = 0,
                                       .srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput |
-                                                      vk::PipelineStageFlagBits::eEarlyFragmentTests,
+                                                      vk::PipelineStageFlagBits::eEarlyFragmentTests |
+                                                      vk::PipelineStageFlagBits::eComputeShader,
                                       .dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput |
                                                       vk::PipelineStageFlagBits::eEarlyFragmentTests,
                                       .srcAccessMask = vk::AccessFlagBits::eNone,
                                       .dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite |
                                                        vk::AccessFlagBits::eDepthStencilAttachmentWrite};
 
+  // Глубина кадра после прохода читается вычислительным шейдером: из неё строится пирамида для отсечения
+  vk::SubpassDependency depthReadDependency = {.srcSubpass = 0,
+                                               .dstSubpass = vk::SubpassExternal,
+                                               .srcStageMask = vk::PipelineStageFlagBits::eLateFragmentTests,
+                                               .dstStageMask = vk::PipelineStageFlagBits::eComputeShader,
+                                               .srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+                                               .dstAccessMask = vk::AccessFlagBits::eShaderRead};
+
+  std::array<vk::SubpassDependency, 2> dependencies = {dependency, depthReadDependency};
   std::array<vk::AttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
   vk::RenderPassCreateInfo renderPassInfo = {.attachmentCount = static_cast<uint32_t>(attachments.size()),
                                              .pAttachments = attachments.data(),
                                              .subpassCount = 1,
                                              .pSubpasses = &subpass,
-                                             .dependencyCount = 1,
-                                             .pDependencies = &dependency};
+                                             .dependencyCount = static_cast<uint32_t>(dependencies.size()),
+                                             .pDependencies = dependencies.data()};
 
   m_renderPass = m_device->getDevice().createRenderPass(renderPassInfo);
 }
@@ -293,7 +312,7 @@ void SwapChainVk::createDepthResources() {
         .arrayLayers = 1,
         .samples = vk::SampleCountFlagBits::e1,
         .tiling = vk::ImageTiling::eOptimal,
-        .usage = vk::ImageUsageFlagBits::eDepthStencilAttachment,
+        .usage = vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled,
         .sharingMode = vk::SharingMode::eExclusive,
         .initialLayout = vk::ImageLayout::eUndefined,
     };
@@ -375,5 +394,5 @@ vk::Format SwapChainVk::findDepthFormat() {
   ZoneScoped;
   return m_device->findSupportedFormat(
       {vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint}, vk::ImageTiling::eOptimal,
-      vk::FormatFeatureFlagBits::eDepthStencilAttachment);
+      vk::FormatFeatureFlagBits::eDepthStencilAttachment | vk::FormatFeatureFlagBits::eSampledImage);
 }
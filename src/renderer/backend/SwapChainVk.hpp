@@ -18,6 +18,8 @@ public:
   inline vk::Framebuffer getFrameBuffer(size_t index) noexcept { return m_swapChainFramebuffers[index]; }
   inline vk::RenderPass getRenderPass() noexcept { return m_renderPass; }
   inline vk::ImageView getImageView(size_t index) noexcept { return m_swapChainImageViews[index]; }
+  // После рендер-пасса в макете eShaderReadOnlyOptimal
+  inline vk::ImageView getDepthImageView(size_t index) noexcept { return m_depthImageViews[index]; }
   inline size_t imageCount() noexcept { return m_swapChainImages.size(); }
   inline vk::Format getSwapChainImageFormat() noexcept { return m_swapChainImageFormat; }
   inline vk::Extent2D getSwapChainExtent() noexcept { return m_swapChainExtent; }
@@ -28,7 +30,9 @@ public:
   vk::Format findDepthFormat();
 
   vk::Result acquireNextImage(uint32_t *imageIndex);
-  vk::Result submitCommandBuffers(const vk::CommandBuffer *buffers, uint32_t *imageIndex);
+  // Кадр дополнительно ждёт значения timelineValue таймлайн-семафора timelineSemaphore
+  vk::Result submitCommandBuffers(const vk::CommandBuffer *buffers, uint32_t *imageIndex,
+                                  vk::Semaphore timelineSemaphore, uint64_t timelineValue);
 
   inline bool compareSwapFormats(const SwapChainVk &other) const noexcept {
     return other.m_swapChainDepthFormat == m_swapChainDepthFormat &&
@@ -2,6 +2,7 @@
 #include "../../assets/Image.hpp"
 #include "BufferVk.hpp"
 #include "RenderDeviceVk.hpp"
+#include "UploadServiceVk.hpp"
 #include <cmath>
 #include <vulkan/vulkan.hpp>
 #include <vulkan/vulkan_core.h>
@@ -33,6 +34,7 @@ TextureVk::~TextureVk() {
 
 void TextureVk::createTextureImage2D() {
   Image img{m_filenames[0]};
+  m_mipLevels = 1;
 
   // Создание текстурного изображения
   vk::ImageCreateInfo imageInfo{};
@@ -55,19 +57,12 @@ void TextureVk::createTextureImage2D() {
   }
 
   // Копирование данных в изображение
-  transitionImageLayout(m_textureImage, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-
-  // Создание временного буфера для загрузки текстуры
-  vk::DeviceSize bufferSize = static_cast<vk::DeviceSize>(img.size());
-  BufferVk stagingBuffer(m_device, bufferSize, 1, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_AUTO,
-                         VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-
-  stagingBuffer.writeToBuffer(img.data());
-
-  copyBufferToImage(stagingBuffer, m_textureImage, static_cast<uint32_t>(img.width()),
-                    static_cast<uint32_t>(img.height()));
-
-  transitionImageLayout(m_textureImage, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+  UploadServiceVk::ImageCopy copy = {
+      .data = std::as_bytes(std::span<const unsigned char>(img.data(), img.size())),
+      .subresource = {vk::ImageAspectFlagBits::eColor, 0, 0, 1},
+      .extent = {static_cast<uint32_t>(img.width()), static_cast<uint32_t>(img.height()), 1},
+  };
+  uploadImage(std::span<const UploadServiceVk::ImageCopy>(&copy, 1));
 }
 
 void TextureVk::createTextureSampler() {
@@ -91,51 +86,12 @@ void TextureVk::createTextureSampler() {
   m_textureSampler = m_device->getDevice().createSampler(samplerInfo);
 }
 
-void TextureVk::transitionImageLayout(vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout) {
-  // Создание командного буфера
-  vk::CommandBuffer commandBuffer = m_device->beginSingleTimeCommands();
-
-  // Установка барьеров (pipeline barriers)
-  vk::ImageMemoryBarrier barrier{};
-  barrier.setOldLayout(oldLayout).setNewLayout(newLayout).setImage(image).setSubresourceRange(
-      {vk::ImageAspectFlagBits::eColor, 0, m_mipLevels, 0, static_cast<uint32_t>(m_filenames.size())});
-
-  // Определение нужных флагов
-  vk::PipelineStageFlags sourceStage;
-  vk::PipelineStageFlags destinationStage;
-
-  if (oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eTransferDstOptimal) {
-    barrier.setSrcAccessMask(vk::AccessFlagBits::eNone).setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
-    sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
-    destinationStage = vk::PipelineStageFlagBits::eTransfer;
-  } else if (oldLayout == vk::ImageLayout::eTransferDstOptimal &&
-             newLayout == vk::ImageLayout::eShaderReadOnlyOptimal) {
-    barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite).setDstAccessMask(vk::AccessFlagBits::eShaderRead);
-    sourceStage = vk::PipelineStageFlagBits::eTransfer;
-    destinationStage = vk::PipelineStageFlagBits::eFragmentShader;
-  }
-  // Другие переходы можно добавить по мере необходимости
-
-  commandBuffer.pipelineBarrier(sourceStage, destinationStage, vk::DependencyFlags{}, nullptr, nullptr, barrier);
-
-  // Завершение командного буфера
-  m_device->endSingleTimeCommands(commandBuffer);
-}
-
-void TextureVk::copyBufferToImage(BufferVk &buffer, vk::Image image, uint32_t width, uint32_t height, uint32_t depth) {
-  vk::CommandBuffer commandBuffer = m_device->beginSingleTimeCommands();
-
-  vk::BufferImageCopy region{};
-  region.setBufferOffset(0)
-      .setBufferRowLength(0)
-      .setBufferImageHeight(0)
-      .setImageSubresource({vk::ImageAspectFlagBits::eColor, 0, 0, 1})
-      .setImageOffset({0, 0, 0})
-      .setImageExtent({width, height, depth});
-
-  commandBuffer.copyBufferToImage(buffer.getBuffer(), image, vk::ImageLayout::eTransferDstOptimal, region);
-
-  m_device->endSingleTimeCommands(commandBuffer);
+void TextureVk::uploadImage(std::span<const UploadServiceVk::ImageCopy> copies) {
+  UploadServiceVk &uploadService = m_device->getUploadService();
+  const vk::ImageSubresourceRange range = {vk::ImageAspectFlagBits::eColor, 0, m_mipLevels, 0,
+                                           static_cast<uint32_t>(m_filenames.size())};
+  // Текстуры создаются до первого кадра и читаются с него же: загрузка дожидается, а захват делает кадр
+  uploadService.wait(uploadService.uploadImage(m_textureImage, range, copies));
 }
 
 void TextureVk::createImageView() {
@@ -196,33 +152,21 @@ void TextureVk::createTextureImage2DArrayWithMipmaps() {
     throw std::runtime_error("failed to create texture image!");
   }
 
-  transitionImageLayout(m_textureImage, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-
+  // Все слои и уровни уходят одной загрузкой
+  std::vector<UploadServiceVk::ImageCopy> copies;
+  copies.reserve(mipDataLayers.size() * m_mipLevels);
   for (size_t layer = 0; layer < mipDataLayers.size(); layer++) {
     for (uint32_t mip = 0; mip < m_mipLevels; mip++) {
       uint32_t mipWidth = std::max(1u, static_cast<uint32_t>(width >> mip));
       uint32_t mipHeight = std::max(1u, static_cast<uint32_t>(height >> mip));
 
-      vk::DeviceSize bufferSize = static_cast<vk::DeviceSize>(mipWidth * mipHeight * static_cast<uint32_t>(channels));
-      BufferVk stagingBuffer(m_device, bufferSize, 1, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_AUTO,
-                             VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-
-      stagingBuffer.writeToBuffer(mipDataLayers[layer][mip].data(), bufferSize, 0);
-
-      vk::BufferImageCopy region{};
-      region.setBufferOffset(0)
-          .setBufferRowLength(0)
-          .setBufferImageHeight(0)
-          .setImageSubresource({vk::ImageAspectFlagBits::eColor, mip, static_cast<uint32_t>(layer), 1})
-          .setImageOffset({0, 0, 0})
-          .setImageExtent({mipWidth, mipHeight, 1});
-
-      vk::CommandBuffer commandBuffer = m_device->beginSingleTimeCommands();
-      commandBuffer.copyBufferToImage(stagingBuffer.getBuffer(), m_textureImage, vk::ImageLayout::eTransferDstOptimal,
-                                      region);
-      m_device->endSingleTimeCommands(commandBuffer);
+      size_t dataSize = static_cast<size_t>(mipWidth * mipHeight * static_cast<uint32_t>(channels));
+      copies.push_back({
+          .data = std::as_bytes(std::span<const unsigned char>(mipDataLayers[layer][mip].data(), dataSize)),
+          .subresource = {vk::ImageAspectFlagBits::eColor, mip, static_cast<uint32_t>(layer), 1},
+          .extent = {mipWidth, mipHeight, 1},
+      });
     }
   }
-
-  transitionImageLayout(m_textureImage, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+  uploadImage(copies);
 }
\ No newline at end of file
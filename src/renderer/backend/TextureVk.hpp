@@ -2,7 +2,9 @@
 
 #include "BufferVk.hpp"
 #include "RenderDeviceVk.hpp"
+#include "UploadServiceVk.hpp"
 #include <cstdint>
+#include <span>
 #include <string>
 
 class TextureVk : NonCopyable {
@@ -25,8 +27,8 @@ public:
 private:
   void createTextureImage2D();
   void createTextureSampler();
-  void transitionImageLayout(vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
-  void copyBufferToImage(BufferVk &buffer, vk::Image image, uint32_t width, uint32_t height, uint32_t depth = 1);
+  // Заполняет все уровни и слои изображения и ждёт конца загрузки
+  void uploadImage(std::span<const UploadServiceVk::ImageCopy> copies);
   void createImageView();
   uint32_t calculateMipLevels(uint32_t width, uint32_t height);
   void createTextureImage2DArrayWithMipmaps();
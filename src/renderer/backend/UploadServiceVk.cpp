@@ -0,0 +1,242 @@
+#include "UploadServiceVk.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <tracy/Tracy.hpp>
+
+UploadServiceVk::UploadServiceVk(RenderDeviceVk *device, uint32_t transferFamily, uint32_t graphicsFamily)
+    : m_device{device}, m_transferFamily{transferFamily}, m_graphicsFamily{graphicsFamily},
+      m_stagingRing{device, STAGING_RING_SIZE} {
+  ZoneScoped;
+  vk::CommandPoolCreateInfo poolInfo = {
+      .flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer | vk::CommandPoolCreateFlagBits::eTransient,
+      .queueFamilyIndex = m_transferFamily,
+  };
+  m_commandPool = m_device->getDevice().createCommandPool(poolInfo);
+
+  vk::SemaphoreTypeCreateInfo typeInfo = {.semaphoreType = vk::SemaphoreType::eTimeline, .initialValue = 0};
+  vk::SemaphoreCreateInfo semaphoreInfo = {.pNext = &typeInfo};
+  m_semaphore = m_device->getDevice().createSemaphore(semaphoreInfo);
+}
+
+UploadServiceVk::~UploadServiceVk() {
+  ZoneScoped;
+  m_device->getTransferQueue().waitIdle();
+  m_batch = {};
+  m_submittedBatches.clear();
+  m_device->getDevice().destroyCommandPool(m_commandPool);
+  m_device->getDevice().destroySemaphore(m_semaphore);
+}
+
+UploadServiceVk::Ticket UploadServiceVk::upload(vk::Buffer dstBuffer, vk::DeviceSize dstOffset,
+                                                std::span<const std::byte> data) {
+  ZoneScoped;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_batch.commandBuffer) {
+    beginBatch();
+  }
+  const Staging staging = allocateStaging(data.size());
+  std::memcpy(staging.allocation.data, data.data(), data.size());
+  flushStaging(staging, data.size());
+  vk::BufferCopy region = {.srcOffset = staging.allocation.offset, .dstOffset = dstOffset, .size = data.size()};
+  m_batch.commandBuffer.copyBuffer(staging.allocation.buffer, dstBuffer, 1, &region);
+  if (m_transferFamily != m_graphicsFamily) {
+    m_batch.ownershipBarriers.push_back({
+        .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+        .dstAccessMask = {},
+        .srcQueueFamilyIndex = m_transferFamily,
+        .dstQueueFamilyIndex = m_graphicsFamily,
+        .buffer = dstBuffer,
+        .offset = dstOffset,
+        .size = data.size(),
+    });
+  }
+  return m_batch.value;
+}
+
+UploadServiceVk::Ticket UploadServiceVk::uploadImage(vk::Image image, const vk::ImageSubresourceRange &range,
+                                                     std::span<const ImageCopy> copies) {
+  ZoneScoped;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_batch.commandBuffer) {
+    beginBatch();
+  }
+  vk::DeviceSize size = 0;
+  for (const ImageCopy &copy : copies) {
+    size = alignStaging(size) + copy.data.size();
+  }
+  const Staging staging = allocateStaging(size);
+  m_imageRegions.clear();
+  vk::DeviceSize offset = 0;
+  for (const ImageCopy &copy : copies) {
+    offset = alignStaging(offset);
+    std::memcpy(staging.allocation.data + offset, copy.data.data(), copy.data.size());
+    m_imageRegions.push_back({
+        .bufferOffset = staging.allocation.offset + offset,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = copy.subresource,
+        .imageOffset = {0, 0, 0},
+        .imageExtent = copy.extent,
+    });
+    offset += copy.data.size();
+  }
+  flushStaging(staging, size);
+
+  vk::ImageMemoryBarrier toTransfer = {
+      .srcAccessMask = {},
+      .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
+      .oldLayout = vk::ImageLayout::eUndefined,
+      .newLayout = vk::ImageLayout::eTransferDstOptimal,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = image,
+      .subresourceRange = range,
+  };
+  m_batch.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+                                        {}, nullptr, nullptr, toTransfer);
+  m_batch.commandBuffer.copyBufferToImage(staging.allocation.buffer, image, vk::ImageLayout::eTransferDstOptimal,
+                                          m_imageRegions);
+  // Смену раскладки при передаче владения повторяет и захват на стороне графики
+  const bool isTransferred = m_transferFamily != m_graphicsFamily;
+  m_batch.imageBarriers.push_back({
+      .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+      .dstAccessMask = {},
+      .oldLayout = vk::ImageLayout::eTransferDstOptimal,
+      .newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+      .srcQueueFamilyIndex = isTransferred ? m_transferFamily : VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = isTransferred ? m_graphicsFamily : VK_QUEUE_FAMILY_IGNORED,
+      .image = image,
+      .subresourceRange = range,
+  });
+  return m_batch.value;
+}
+
+void UploadServiceVk::submit() {
+  ZoneScoped;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_batch.commandBuffer) {
+    return;
+  }
+  if (!m_batch.ownershipBarriers.empty() || !m_batch.imageBarriers.empty()) {
+    m_batch.commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, 0, nullptr,
+        static_cast<uint32_t>(m_batch.ownershipBarriers.size()), m_batch.ownershipBarriers.data(),
+        static_cast<uint32_t>(m_batch.imageBarriers.size()), m_batch.imageBarriers.data());
+  }
+  m_batch.commandBuffer.end();
+
+  vk::TimelineSemaphoreSubmitInfo timelineInfo = {
+      .signalSemaphoreValueCount = 1,
+      .pSignalSemaphoreValues = &m_batch.value,
+  };
+  vk::SubmitInfo submitInfo = {
+      .pNext = &timelineInfo,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &m_batch.commandBuffer,
+      .signalSemaphoreCount = 1,
+      .pSignalSemaphores = &m_semaphore,
+  };
+  m_device->getTransferQueue().submit(submitInfo, nullptr);
+  m_stagingRing.close(m_batch.value);
+  m_submittedBatches.push_back(std::move(m_batch));
+  m_batch = {};
+}
+
+void UploadServiceVk::acquireCompleted(vk::CommandBuffer commandBuffer) {
+  ZoneScoped;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const uint64_t completedValue = m_device->getDevice().getSemaphoreCounterValue(m_semaphore);
+  uint64_t acquiredValue = m_acquiredValue.load(std::memory_order_relaxed);
+  m_acquireBarriers.clear();
+  m_acquireImageBarriers.clear();
+  while (!m_submittedBatches.empty() && m_submittedBatches.front().value <= completedValue) {
+    Batch &batch = m_submittedBatches.front();
+    // Захват повторяет параметры освобождения, но доступ задаёт на стороне графики
+    for (vk::BufferMemoryBarrier barrier : batch.ownershipBarriers) {
+      barrier.srcAccessMask = {};
+      barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+      m_acquireBarriers.push_back(barrier);
+    }
+    if (m_transferFamily != m_graphicsFamily) {
+      for (vk::ImageMemoryBarrier barrier : batch.imageBarriers) {
+        barrier.srcAccessMask = {};
+        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+        m_acquireImageBarriers.push_back(barrier);
+      }
+    }
+    m_freeCommandBuffers.push_back(batch.commandBuffer);
+    acquiredValue = batch.value;
+    m_submittedBatches.pop_front();
+  }
+  m_stagingRing.reclaim(completedValue);
+  if (!m_acquireBarriers.empty() || !m_acquireImageBarriers.empty()) {
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eAllCommands, {},
+                                  0, nullptr, static_cast<uint32_t>(m_acquireBarriers.size()),
+                                  m_acquireBarriers.data(), static_cast<uint32_t>(m_acquireImageBarriers.size()),
+                                  m_acquireImageBarriers.data());
+  }
+  m_acquiredValue.store(acquiredValue, std::memory_order_release);
+}
+
+void UploadServiceVk::wait(Ticket ticket) {
+  ZoneScoped;
+  // Билет мог остаться в ещё не отправленной пачке
+  submit();
+  vk::SemaphoreWaitInfo waitInfo = {.semaphoreCount = 1, .pSemaphores = &m_semaphore, .pValues = &ticket};
+  if (m_device->getDevice().waitSemaphores(waitInfo, UINT64_MAX) != vk::Result::eSuccess) {
+    throw std::runtime_error("failed to wait for upload!");
+  }
+}
+
+bool UploadServiceVk::isComplete(Ticket ticket) const {
+  return ticket <= m_device->getDevice().getSemaphoreCounterValue(m_semaphore);
+}
+
+void UploadServiceVk::beginBatch() {
+  if (m_freeCommandBuffers.empty()) {
+    vk::CommandBufferAllocateInfo allocInfo = {
+        .commandPool = m_commandPool,
+        .level = vk::CommandBufferLevel::ePrimary,
+        .commandBufferCount = 1,
+    };
+    m_freeCommandBuffers.push_back(m_device->getDevice().allocateCommandBuffers(allocInfo).front());
+  }
+  m_batch.value = m_nextValue++;
+  m_batch.commandBuffer = m_freeCommandBuffers.back();
+  m_freeCommandBuffers.pop_back();
+  m_batch.commandBuffer.reset();
+  vk::CommandBufferBeginInfo beginInfo = {.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit};
+  m_batch.commandBuffer.begin(beginInfo);
+}
+
+UploadServiceVk::Staging UploadServiceVk::allocateStaging(vk::DeviceSize size) {
+  std::optional<StagingRingVk::Allocation> allocation = m_stagingRing.allocate(size, STAGING_ALIGNMENT);
+  if (!allocation) {
+    // Место могли освободить пачки, выполненные после прошлого acquireCompleted
+    m_stagingRing.reclaim(m_device->getDevice().getSemaphoreCounterValue(m_semaphore));
+    allocation = m_stagingRing.allocate(size, STAGING_ALIGNMENT);
+  }
+  if (allocation) {
+    return {.allocation = *allocation, .dedicatedBuffer = nullptr};
+  }
+  // Кольцо занято или мало: загрузка не ждёт GPU, а получает свой буфер на время пачки
+  auto stagingBuffer = std::make_unique<BufferVk>(
+      m_device, size, 1, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_AUTO,
+      VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+  Staging staging = {
+      .allocation = {.buffer = stagingBuffer->getBuffer(),
+                     .offset = 0,
+                     .data = static_cast<std::byte *>(stagingBuffer->getMappedData())},
+      .dedicatedBuffer = stagingBuffer.get(),
+  };
+  m_batch.stagingBuffers.push_back(std::move(stagingBuffer));
+  return staging;
+}
+
+void UploadServiceVk::flushStaging(const Staging &staging, vk::DeviceSize size) {
+  if (staging.dedicatedBuffer) {
+    staging.dedicatedBuffer->flush(size);
+    return;
+  }
+  m_stagingRing.flush(staging.allocation, size);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "../../core/NonCopyable.hpp"
+#include "BufferVk.hpp"
+#include "StagingRingVk.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+// Загрузки в буферы и изображения GPU через очередь передачи, без ожидания на CPU. Копирования копятся в пачку
+// и уходят одной отправкой за кадр; отправка сигналит следующее значение таймлайн-семафора.
+// Данные копируются в кольцо промежуточной памяти, место в котором возвращается по выполнении пачки.
+// Если семейство передачи не графическое, пачка освобождает владение записанными диапазонами, а кадр графики
+// захватывает их только после выполнения пачки - ожидание семафора в отправке кадра уже ничего не ждёт.
+class UploadServiceVk : NonCopyable {
+public:
+  // Значение таймлайн-семафора пачки, в которую попала загрузка
+  using Ticket = uint64_t;
+  // Часть изображения целиком: data плотно упакована по строкам
+  struct ImageCopy {
+    std::span<const std::byte> data;
+    vk::ImageSubresourceLayers subresource;
+    vk::Extent3D extent;
+  };
+
+  static constexpr vk::DeviceSize STAGING_RING_SIZE = 16 * 1024 * 1024;
+  // Смещения копий в изображения должны быть кратны размеру texel и четырём
+  static constexpr vk::DeviceSize STAGING_ALIGNMENT = 16;
+
+  UploadServiceVk(RenderDeviceVk *device, uint32_t transferFamily, uint32_t graphicsFamily);
+  ~UploadServiceVk();
+
+  // Копирует data в dstBuffer со смещения dstOffset в текущей пачке. Можно звать из любого потока
+  Ticket upload(vk::Buffer dstBuffer, vk::DeviceSize dstOffset, std::span<const std::byte> data);
+  // Заполняет range изображения частями copies; после загрузки range в раскладке eShaderReadOnlyOptimal.
+  // Прежнее содержимое range теряется
+  Ticket uploadImage(vk::Image image, const vk::ImageSubresourceRange &range, std::span<const ImageCopy> copies);
+  // Отправляет накопленную пачку
+  void submit();
+  // Пишет в командный буфер кадра захват диапазонов выполненных пачек и освобождает их ресурсы.
+  // Зовётся до любых команд кадра, читающих загруженное
+  void acquireCompleted(vk::CommandBuffer commandBuffer);
+  // Отправляет пачку и ждёт выполнения загрузки на CPU. Графика захватит её в следующем acquireCompleted
+  void wait(Ticket ticket);
+
+  // Загрузка выполнена очередью передачи, но графика могла её ещё не захватить
+  bool isComplete(Ticket ticket) const;
+  // Загрузку можно читать командам графики, записанным после последнего acquireCompleted
+  inline bool isReady(Ticket ticket) const noexcept {
+    return ticket <= m_acquiredValue.load(std::memory_order_acquire);
+  }
+  // Отправка кадра ждёт семафор со значением getAcquiredValue: захват не должен обогнать освобождение
+  inline vk::Semaphore getSemaphore() const noexcept { return m_semaphore; }
+  inline uint64_t getAcquiredValue() const noexcept { return m_acquiredValue.load(std::memory_order_acquire); }
+
+private:
+  struct Batch {
+    Ticket value;
+    vk::CommandBuffer commandBuffer;
+    // Свои промежуточные буферы у загрузок, не поместившихся в кольцо; живут до выполнения пачки
+    std::vector<std::unique_ptr<BufferVk>> stagingBuffers;
+    // Диапазоны, передаваемые графике; пусто, если семейство у очередей одно
+    std::vector<vk::BufferMemoryBarrier> ownershipBarriers;
+    // Переходы изображений в раскладку для шейдеров; при разных семействах они же передают владение
+    std::vector<vk::ImageMemoryBarrier> imageBarriers;
+  };
+  struct Staging {
+    StagingRingVk::Allocation allocation;
+    // nullptr, если место выделено в кольце
+    BufferVk *dedicatedBuffer;
+  };
+
+  void beginBatch();
+  // Место для size байт текущей пачки. Зовётся под m_mutex
+  Staging allocateStaging(vk::DeviceSize size);
+  void flushStaging(const Staging &staging, vk::DeviceSize size);
+  static inline vk::DeviceSize alignStaging(vk::DeviceSize offset) noexcept {
+    return (offset + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+  }
+
+  RenderDeviceVk *m_device;
+  uint32_t m_transferFamily;
+  uint32_t m_graphicsFamily;
+  vk::CommandPool m_commandPool;
+  vk::Semaphore m_semaphore;
+  std::mutex m_mutex;
+  StagingRingVk m_stagingRing;
+  Batch m_batch = {};
+  Ticket m_nextValue = 1;
+  std::deque<Batch> m_submittedBatches;
+  std::vector<vk::CommandBuffer> m_freeCommandBuffers;
+  std::vector<vk::BufferMemoryBarrier> m_acquireBarriers;
+  std::vector<vk::ImageMemoryBarrier> m_acquireImageBarriers;
+  std::vector<vk::BufferImageCopy> m_imageRegions;
+  std::atomic<uint64_t> m_acquiredValue = 0;
+};
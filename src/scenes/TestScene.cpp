@@ -42,8 +42,8 @@ TestScene::TestScene(RenderDeviceVk *device, Renderer *renderer, Keyboard *keybo
     DescriptorWriterVk(*globalSetLayout, *globalPool).writeBuffer(0, &bufferInfo).build(m_globalDescriptorSets[i]);
   }
 
-  m_gridRenderSystem = std::make_unique<GridRenderSystem>(m_device, m_renderer->getSwapChainRenderPass(),
-                                                          globalSetLayout->getDescriptorSetLayout());
+  m_gridRenderSystem = std::make_unique<GridRenderSystem>(
+      m_device, m_renderer->getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout(), &m_renderQueue);
 }
 
 TestScene::~TestScene() {
@@ -99,6 +99,10 @@ void TestScene::update(float dt) {
   }
 }
 
+void TestScene::preRender(vk::CommandBuffer commandBuffer) {}
+
+void TestScene::postRender(vk::CommandBuffer commandBuffer) {}
+
 void TestScene::render(vk::CommandBuffer commandBuffer) {
   ZoneScoped;
   m_ubo.projectionView = m_camera->getProjectionMatrix() * m_camera->getViewMatrix();
@@ -111,6 +115,7 @@ void TestScene::render(vk::CommandBuffer commandBuffer) {
       .commandBuffer = commandBuffer,
       .playerX = m_playerController.getChunkX(),
       .playerZ = m_playerController.getChunkZ(),
+      .cameraPosition = m_camera->getPosition(),
       .globalDescriptorSet = m_globalDescriptorSets[frameIndex],
       .frameIndex = frameIndex,
   };
@@ -118,7 +123,8 @@ void TestScene::render(vk::CommandBuffer commandBuffer) {
   m_globalBuffers[frameIndex]->writeToBuffer(&m_ubo);
   m_globalBuffers[frameIndex]->flush();
 
-  m_gridRenderSystem->render(frameData);
+  m_gridRenderSystem->submit(frameData);
+  m_renderQueue.execute(frameData);
 }
 
 void TestScene::renderUI() {
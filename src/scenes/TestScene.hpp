@@ -23,7 +23,9 @@ public:
   ~TestScene();
 
   void update(float dt);
+  void preRender(vk::CommandBuffer commandBuffer);
   void render(vk::CommandBuffer commandBuffer);
+  void postRender(vk::CommandBuffer commandBuffer);
   void renderUI();
 
 private:
@@ -32,6 +34,7 @@ private:
   Mouse *m_mouse;
   Window *m_window;
   std::unique_ptr<DescriptorPoolVk> globalPool{};
+  RenderQueue m_renderQueue;
   std::unique_ptr<GridRenderSystem> m_gridRenderSystem;
   std::unique_ptr<Camera> m_camera;
   PlayerController m_playerController;
@@ -0,0 +1,78 @@
+#include "BiomeMap.hpp"
+#include <cassert>
+#include <cmath>
+#include <tracy/Tracy.hpp>
+
+namespace {
+constexpr float CLIMATE_SPREAD_SQ = 0.35f * 0.35f;
+
+constexpr std::array<BiomeParams, BiomeMap::BIOMES_COUNT> BIOMES = {{
+    // temperature, humidity, baseHeight, heightScale, surface, subsurface, decorationDensity
+    {0.0f, 0.9f, 50.0f, 8.0f, BlockId::Sand, BlockId::Sand, 0.0f},      // Ocean
+    {0.0f, 0.0f, 70.0f, 10.0f, BlockId::Grass, BlockId::Dirt, 0.005f},  // Plains
+    {0.8f, -0.7f, 67.0f, 6.0f, BlockId::Sand, BlockId::Sand, 0.0f},     // Desert
+    {-0.2f, 0.5f, 72.0f, 16.0f, BlockId::Grass, BlockId::Dirt, 0.06f},  // Forest
+    {-0.7f, -0.4f, 96.0f, 40.0f, BlockId::Stone, BlockId::Stone, 0.0f}, // Mountains
+}};
+} // namespace
+
+const BiomeParams &BiomeMap::getParams(BiomeId biome) noexcept { return BIOMES[static_cast<size_t>(biome)]; }
+
+std::array<float, BiomeMap::BIOMES_COUNT> BiomeMap::computeWeights(float temperature, float humidity) noexcept {
+  std::array<float, BIOMES_COUNT> weights;
+  float sum = 0.0f;
+  for (size_t i = 0; i < BIOMES_COUNT; i++) {
+    const float dt = temperature - BIOMES[i].temperature;
+    const float dh = humidity - BIOMES[i].humidity;
+    weights[i] = std::exp(-(dt * dt + dh * dh) / CLIMATE_SPREAD_SQ);
+    sum += weights[i];
+  }
+  for (auto &weight : weights) {
+    weight /= sum;
+  }
+  return weights;
+}
+
+void BiomeMap::build(std::span<const float> gridTemperatures, std::span<const float> gridHumidities) noexcept {
+  ZoneScoped;
+  assert(gridTemperatures.size() >= GRID_SQ_SIZE && gridHumidities.size() >= GRID_SQ_SIZE);
+
+  std::array<std::array<float, BIOMES_COUNT>, GRID_SQ_SIZE> gridWeights;
+  for (size_t i = 0; i < GRID_SQ_SIZE; i++) {
+    gridWeights[i] = computeWeights(gridTemperatures[i], gridHumidities[i]);
+  }
+
+  constexpr float invStep = 1.0f / GRID_STEP;
+  for (int z = 0; z < SIZE; z++) {
+    const int gz = z / GRID_STEP;
+    const float fz = static_cast<float>(z % GRID_STEP) * invStep;
+    for (int x = 0; x < SIZE; x++) {
+      const int gx = x / GRID_STEP;
+      const float fx = static_cast<float>(x % GRID_STEP) * invStep;
+
+      const auto &w00 = gridWeights[gx + gz * GRID_SIZE];
+      const auto &w10 = gridWeights[gx + 1 + gz * GRID_SIZE];
+      const auto &w01 = gridWeights[gx + (gz + 1) * GRID_SIZE];
+      const auto &w11 = gridWeights[gx + 1 + (gz + 1) * GRID_SIZE];
+
+      const size_t columnIdx = getColumnIdx(x, z);
+      auto &weights = m_weights[columnIdx];
+      auto &column = m_columns[columnIdx];
+      column = {.baseHeight = 0.0f, .heightScale = 0.0f, .decorationDensity = 0.0f, .dominantBiome = BiomeId::Plains};
+      float maxWeight = -1.0f;
+      for (size_t i = 0; i < BIOMES_COUNT; i++) {
+        const float top = w00[i] + (w10[i] - w00[i]) * fx;
+        const float bottom = w01[i] + (w11[i] - w01[i]) * fx;
+        weights[i] = top + (bottom - top) * fz;
+
+        column.baseHeight += weights[i] * BIOMES[i].baseHeight;
+        column.heightScale += weights[i] * BIOMES[i].heightScale;
+        column.decorationDensity += weights[i] * BIOMES[i].decorationDensity;
+        if (weights[i] > maxWeight) {
+          maxWeight = weights[i];
+          column.dominantBiome = static_cast<BiomeId>(i);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "BlockId.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+enum class BiomeId : uint8_t { Ocean, Plains, Desert, Forest, Mountains, Count };
+
+struct BiomeParams {
+  // Центр биома в пространстве климата (температура, влажность), оба в [-1, 1]
+  float temperature;
+  float humidity;
+  float baseHeight;
+  float heightScale;
+  BlockId surfaceBlock;
+  BlockId subsurfaceBlock;
+  float decorationDensity;
+};
+
+struct BiomeColumn {
+  float baseHeight;
+  float heightScale;
+  float decorationDensity;
+  BiomeId dominantBiome;
+};
+
+// Веса биомов для каждой колонки чанка. Климат сэмплируется на грубой сетке
+// (шаг GRID_STEP блоков) и билинейно интерполируется, поэтому шум считается один раз на чанк.
+class BiomeMap {
+public:
+  static constexpr int SIZE = 16;
+  static constexpr int GRID_STEP = 4;
+  static constexpr int GRID_SIZE = SIZE / GRID_STEP + 1;
+  static constexpr int GRID_SQ_SIZE = GRID_SIZE * GRID_SIZE;
+  static constexpr size_t BIOMES_COUNT = static_cast<size_t>(BiomeId::Count);
+
+  void build(std::span<const float> gridTemperatures, std::span<const float> gridHumidities) noexcept;
+
+  inline float getWeight(int x, int z, BiomeId biome) const noexcept {
+    return m_weights[getColumnIdx(x, z)][static_cast<size_t>(biome)];
+  }
+  inline const std::array<float, BIOMES_COUNT> &getWeights(int x, int z) const noexcept {
+    return m_weights[getColumnIdx(x, z)];
+  }
+  inline const BiomeColumn &getColumn(int x, int z) const noexcept { return m_columns[getColumnIdx(x, z)]; }
+  inline BiomeId getDominantBiome(int x, int z) const noexcept { return getColumn(x, z).dominantBiome; }
+
+  static const BiomeParams &getParams(BiomeId biome) noexcept;
+
+private:
+  inline static size_t getColumnIdx(int x, int z) noexcept { return static_cast<size_t>(x + z * SIZE); }
+  static std::array<float, BIOMES_COUNT> computeWeights(float temperature, float humidity) noexcept;
+
+private:
+  std::array<std::array<float, BIOMES_COUNT>, SIZE * SIZE> m_weights;
+  std::array<BiomeColumn, SIZE * SIZE> m_columns;
+};
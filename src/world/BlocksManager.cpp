@@ -1,24 +1,25 @@
 #include "BlocksManager.hpp"
 #include "../assets/BlockLoader.hpp"
 
-BlocksManager::BlocksManager(std::string_view blocksPath, TextureAtlas &textureAtlas) : m_textureAtlas{textureAtlas} {
-  loadBlocks(blocksPath);
+BlocksManager::BlocksManager(std::string_view blocksPath, const TextureAtlas::TexturesIndices &texturesIndices) {
+  loadBlocks(blocksPath, texturesIndices);
 }
 
-void BlocksManager::loadBlocks(std::string_view blocksPath) {
+void BlocksManager::loadBlocks(std::string_view blocksPath, const TextureAtlas::TexturesIndices &texturesIndices) {
   BlockLoader loader(blocksPath);
   auto loadedBlocks = loader.loadBlocks(blocksPath);
 
+  auto getTextureIdx = [&](const std::string &textureName) { return texturesIndices.find(textureName)->second; };
   for (auto &block : loadedBlocks) {
     if (block.id() == BlockId::Air) {
       continue;
     }
-    block.setTexturesIndices(m_textureAtlas.getTextureIdx(block.getFaceTextureName(Block::Faces::Front)),
-                             m_textureAtlas.getTextureIdx(block.getFaceTextureName(Block::Faces::Back)),
-                             m_textureAtlas.getTextureIdx(block.getFaceTextureName(Block::Faces::Top)),
-                             m_textureAtlas.getTextureIdx(block.getFaceTextureName(Block::Faces::Bottom)),
-                             m_textureAtlas.getTextureIdx(block.getFaceTextureName(Block::Faces::Left)),
-                             m_textureAtlas.getTextureIdx(block.getFaceTextureName(Block::Faces::Right)));
+    block.setTexturesIndices(getTextureIdx(block.getFaceTextureName(Block::Faces::Front)),
+                             getTextureIdx(block.getFaceTextureName(Block::Faces::Back)),
+                             getTextureIdx(block.getFaceTextureName(Block::Faces::Top)),
+                             getTextureIdx(block.getFaceTextureName(Block::Faces::Bottom)),
+                             getTextureIdx(block.getFaceTextureName(Block::Faces::Left)),
+                             getTextureIdx(block.getFaceTextureName(Block::Faces::Right)));
     m_blocks[static_cast<size_t>(block.id())] = block;
   }
 }
@@ -8,14 +8,13 @@
 
 class BlocksManager {
 public:
-  BlocksManager(std::string_view blocksPath, TextureAtlas &textureAtlas);
+  BlocksManager(std::string_view blocksPath, const TextureAtlas::TexturesIndices &texturesIndices);
 
   inline Block &getBlockById(BlockId id) noexcept { return m_blocks[static_cast<size_t>(id)]; };
 
 private:
-  void loadBlocks(std::string_view blocksPath);
+  void loadBlocks(std::string_view blocksPath, const TextureAtlas::TexturesIndices &texturesIndices);
 
 private:
   std::array<Block, static_cast<size_t>(BlockId::Count)> m_blocks;
-  TextureAtlas &m_textureAtlas;
 };
\ No newline at end of file
@@ -1,5 +1,8 @@
 #include "Chunk.hpp"
 #include "BlockId.hpp"
+#include <algorithm>
+#include <array>
+#include <bitset>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
@@ -7,25 +10,72 @@
 #include <tracy/Tracy.hpp>
 #include <vector>
 
+namespace {
+std::array<std::atomic_int, CHUNK_STATES_COUNT> stateCounts{};
+} // namespace
+
 Chunk::Chunk(BlocksManager &blocksManager, int x, int z)
-    : m_x{x}, m_z{z}, m_worldX{toWorldPos(x)}, m_worldZ{toWorldPos(z)}, m_blocksManager{blocksManager} {}
-
-void Chunk::generateMesh(RenderDeviceVk *device) {
-  bool expected = false;
-  if (m_isLocked.compare_exchange_strong(expected, true)) {
-    if (m_vertices.empty()) {
-      m_isLocked.store(false);
-      return;
-    }
+    : m_x{x}, m_z{z}, m_worldX{toWorldPos(x)}, m_worldZ{toWorldPos(z)}, m_blocksManager{blocksManager} {
+  stateCounts[static_cast<size_t>(ChunkState::Generating)].fetch_add(1, std::memory_order_relaxed);
+}
+
+Chunk::~Chunk() {
+  stateCounts[static_cast<size_t>(m_state.load())].fetch_sub(1, std::memory_order_relaxed);
+  // Чанк, пропавший из сетки или кэша мимо setMemoryAccount, не должен остаться в счётчике
+  exchangeMemoryUsage(MEMORY_USAGE_MASK, 0);
+}
+
+int Chunk::getStateCount(ChunkState state) noexcept {
+  return stateCounts[static_cast<size_t>(state)].load(std::memory_order_relaxed);
+}
+
+bool Chunk::tryTransition(ChunkState from, ChunkState to) noexcept {
+  if (!m_state.compare_exchange_strong(from, to, std::memory_order_acq_rel)) {
+    return false;
+  }
+  stateCounts[static_cast<size_t>(from)].fetch_sub(1, std::memory_order_relaxed);
+  stateCounts[static_cast<size_t>(to)].fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void Chunk::markEvicting() noexcept {
+  const ChunkState from = m_state.exchange(ChunkState::Evicting, std::memory_order_acq_rel);
+  stateCounts[static_cast<size_t>(from)].fetch_sub(1, std::memory_order_relaxed);
+  stateCounts[static_cast<size_t>(ChunkState::Evicting)].fetch_add(1, std::memory_order_relaxed);
+}
 
-    std::vector<ChunkVertex> tempVertices;
-    std::swap(m_vertices, tempVertices);
-    std::vector<uint32_t> tempIndices;
-    std::swap(m_indices, tempIndices);
-    m_mesh = std::make_shared<Mesh<ChunkVertex>>(device, tempVertices, tempIndices);
-    m_isMeshOutdated = false;
-    m_isLocked.store(false);
+bool Chunk::markDirty() noexcept {
+  m_version.fetch_add(1, std::memory_order_acq_rel);
+  // Мешинг и загрузка сами увидят новую версию, когда закончат
+  return tryTransition(ChunkState::Resident, ChunkState::Generated) || getState() == ChunkState::Generated;
+}
+
+size_t Chunk::generateMesh(MeshArena *arena) {
+  ZoneScoped;
+  if (!tryTransition(ChunkState::MeshReady, ChunkState::Uploading)) {
+    return 0;
   }
+  std::vector<ChunkVertex> tempVertices;
+  std::swap(m_vertices, tempVertices);
+  std::vector<uint32_t> tempIndices;
+  std::swap(m_indices, tempIndices);
+
+  const bool isStale = m_verticesVersion != getVersion();
+  size_t uploadedBytes = 0;
+  // Устаревший меш загружаем, только если показывать пока нечего
+  if (!isStale || !m_hasMesh) {
+    m_mesh = tempVertices.empty() || !arena ? nullptr
+                                            : std::make_shared<Mesh<ChunkVertex>>(arena, tempVertices, tempIndices);
+    m_meshSections.store(m_verticesSections, std::memory_order_release);
+    m_meshBounds.store(static_cast<uint32_t>(m_verticesBounds.minY) |
+                           (static_cast<uint32_t>(m_verticesBounds.maxY) << 16),
+                       std::memory_order_release);
+    m_hasMesh = true;
+    uploadedBytes = tempVertices.size() * sizeof(ChunkVertex) + tempIndices.size() * sizeof(uint32_t);
+  }
+  updateMemoryUsage();
+  tryTransition(ChunkState::Uploading, isStale ? ChunkState::Generated : ChunkState::Resident);
+  return uploadedBytes;
 }
 
 void Chunk::addFrontFace(int x, int y, int z, float textureIdx) {
@@ -156,22 +206,32 @@ void Chunk::addBottomFace(int x, int y, int z, float textureIdx) {
 
 int Chunk::toWorldPos(int x) { return x * Chunk::CHUNK_SIZE; }
 
-void Chunk::generateVerticesAndIndices(std::shared_ptr<Chunk> front, std::shared_ptr<Chunk> back,
+bool Chunk::generateVerticesAndIndices(std::shared_ptr<Chunk> front, std::shared_ptr<Chunk> back,
                                        std::shared_ptr<Chunk> left, std::shared_ptr<Chunk> right) {
   ZoneScoped;
-  bool expected = false;
   assert(!front || front->z() == z() - 1);
   assert(!back || back->z() == z() + 1);
   assert(!left || left->x() == x() - 1);
   assert(!right || right->x() == x() + 1);
-  if (!m_isLocked.compare_exchange_strong(expected, true)) {
-    return;
+  if (!tryTransition(ChunkState::Generated, ChunkState::Meshing)) {
+    return false;
   }
+  // Запоминаем версию до чтения вокселей, чтобы изменения во время мешинга сделали результат устаревшим
+  const uint32_t version = getVersion();
+  m_vertices.clear();
+  m_indices.clear();
   m_vertices.reserve(6000);
   m_indices.reserve(9000);
 
+  VerticalBounds bounds = {CHUNK_HEIGHT, 0};
+  auto sections = std::make_shared<MeshSections>();
   size_t voxelIdx = 0;
   for (int y = 0; y < m_maxY; y++) {
+    const size_t layerStart = m_vertices.size();
+    // Грани добавляются слоями снизу вверх, поэтому индексы секции идут одним отрезком
+    if (y % SECTION_SIZE == 0) {
+      sections->indexOffsets[y / SECTION_SIZE] = static_cast<uint32_t>(m_indices.size());
+    }
     for (int z = 0; z < CHUNK_SIZE; z++) {
       for (int x = 0; x < CHUNK_SIZE; x++) {
         auto &block = m_blocksManager.getBlockById(m_voxels[voxelIdx++].blockId);
@@ -226,10 +286,127 @@ void Chunk::generateVerticesAndIndices(std::shared_ptr<Chunk> front, std::shared
         }
       }
     }
+    if (m_vertices.size() > layerStart) {
+      bounds.minY = std::min(bounds.minY, y);
+      bounds.maxY = y + 1;
+    }
+  }
+  if (version != getVersion()) {
+    std::vector<ChunkVertex>().swap(m_vertices);
+    std::vector<uint32_t>().swap(m_indices);
+    updateMemoryUsage();
+    tryTransition(ChunkState::Meshing, ChunkState::Generated);
+    return false;
+  }
+  m_verticesVersion = version;
+  m_verticesBounds = bounds.isEmpty() ? VerticalBounds{0, 0} : bounds;
+  for (int section = (m_maxY + SECTION_SIZE - 1) / SECTION_SIZE; section <= SECTIONS_COUNT; section++) {
+    sections->indexOffsets[section] = static_cast<uint32_t>(m_indices.size());
+  }
+  for (int section = 0; section < SECTIONS_COUNT; section++) {
+    sections->connectivity[section] = computeSectionConnectivity(section);
+  }
+  m_verticesSections = std::move(sections);
+  m_missingNeighbors.store((front ? 0 : FRONT_NEIGHBOR) | (back ? 0 : BACK_NEIGHBOR) | (left ? 0 : LEFT_NEIGHBOR) |
+                               (right ? 0 : RIGHT_NEIGHBOR),
+                           std::memory_order_release);
+  updateMemoryUsage();
+  return tryTransition(ChunkState::Meshing, ChunkState::MeshReady);
+}
+
+void Chunk::updateMemoryUsage() noexcept {
+  size_t usage = m_voxels.capacity() * sizeof(Voxel);
+  usage += m_vertices.capacity() * sizeof(ChunkVertex) + m_indices.capacity() * sizeof(uint32_t);
+  if (m_mesh) {
+    usage += m_mesh->getVertexCount() * sizeof(ChunkVertex) + m_mesh->getIndexCount() * sizeof(uint32_t);
+  }
+  exchangeMemoryUsage(~MEMORY_USAGE_MASK, usage);
+}
+
+void Chunk::setMemoryAccount(const std::shared_ptr<MemoryCounters> &counters, MemoryAccount account) noexcept {
+  if (!m_memoryCounters) {
+    m_memoryCounters = counters;
+  }
+  exchangeMemoryUsage(MEMORY_USAGE_MASK, static_cast<size_t>(account) << MEMORY_ACCOUNT_SHIFT);
+}
+
+void Chunk::exchangeMemoryUsage(size_t keepMask, size_t bits) noexcept {
+  size_t packed = m_memoryUsage.load(std::memory_order_relaxed);
+  size_t nextPacked = 0;
+  do {
+    nextPacked = (packed & keepMask) | bits;
+  } while (!m_memoryUsage.compare_exchange_weak(packed, nextPacked, std::memory_order_relaxed));
+  const auto account = static_cast<MemoryAccount>(packed >> MEMORY_ACCOUNT_SHIFT);
+  const auto nextAccount = static_cast<MemoryAccount>(nextPacked >> MEMORY_ACCOUNT_SHIFT);
+  if (auto *counter = getMemoryCounter(account)) {
+    counter->bytes.fetch_sub(static_cast<int64_t>(packed & MEMORY_USAGE_MASK), std::memory_order_relaxed);
+    counter->chunks.fetch_sub(account != nextAccount ? 1 : 0, std::memory_order_relaxed);
+  }
+  if (auto *counter = getMemoryCounter(nextAccount)) {
+    counter->bytes.fetch_add(static_cast<int64_t>(nextPacked & MEMORY_USAGE_MASK), std::memory_order_relaxed);
+    counter->chunks.fetch_add(account != nextAccount ? 1 : 0, std::memory_order_relaxed);
+  }
+}
+
+Chunk::MemoryCounter *Chunk::getMemoryCounter(MemoryAccount account) const noexcept {
+  if (!m_memoryCounters) {
+    return nullptr;
+  }
+  switch (account) {
+  case MemoryAccount::Grid:
+    return &m_memoryCounters->grid;
+  case MemoryAccount::Cache:
+    return &m_memoryCounters->cache;
+  default:
+    return nullptr;
+  }
+}
+
+uint16_t Chunk::computeSectionConnectivity(int section) const {
+  ZoneScoped;
+  constexpr int SECTION_VOLUME = SECTION_SIZE * SECTION_SIZE * SECTION_SIZE;
+  const size_t baseIdx = static_cast<size_t>(section) * SECTION_SIZE * CHUNK_SQ_SIZE;
+  // Секция выше сохранённых вокселей целиком из воздуха
+  if (baseIdx >= m_voxels.size()) {
+    return SectionConnectivity::ALL_CONNECTED;
+  }
+
+  // Индекс внутри секции устроен как в m_voxels: x + z * 16 + y * 256
+  std::bitset<SECTION_VOLUME> visited;
+  std::array<uint16_t, SECTION_VOLUME> stack;
+  uint16_t connectivity = 0;
+  for (int start = 0; start < SECTION_VOLUME; start++) {
+    if (visited[start] || !canAddFace(baseIdx + start)) {
+      continue;
+    }
+    uint8_t faces = 0;
+    size_t stackSize = 0;
+    stack[stackSize++] = static_cast<uint16_t>(start);
+    visited[start] = true;
+    while (stackSize > 0) {
+      const int idx = stack[--stackSize];
+      const int coords[3] = {idx % SECTION_SIZE, idx / CHUNK_SQ_SIZE, (idx / SECTION_SIZE) % SECTION_SIZE};
+      for (int face = 0; face < SectionConnectivity::FACES_COUNT; face++) {
+        const auto &direction = SectionConnectivity::FACE_DIRECTIONS[face];
+        const int axis = face / 2;
+        const int coord = coords[axis] + direction[axis];
+        if (coord < 0 || coord >= SECTION_SIZE) {
+          faces |= static_cast<uint8_t>(1 << face);
+          continue;
+        }
+        const int neighborIdx = idx + direction[0] + direction[2] * SECTION_SIZE + direction[1] * CHUNK_SQ_SIZE;
+        if (!visited[neighborIdx] && canAddFace(baseIdx + neighborIdx)) {
+          visited[neighborIdx] = true;
+          stack[stackSize++] = static_cast<uint16_t>(neighborIdx);
+        }
+      }
+    }
+    connectivity |= SectionConnectivity::connectFaces(faces);
+    if (connectivity == SectionConnectivity::ALL_CONNECTED) {
+      break;
+    }
   }
-  m_isModified = false;
-  m_isMeshOutdated = true;
-  m_isLocked.store(false);
+  return connectivity;
 }
 
 void Chunk::shrinkAirBlocks() {
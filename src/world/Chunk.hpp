@@ -2,20 +2,60 @@
 
 #include "../renderSystems/ChunkVertex.hpp"
 #include "../renderer/Mesh.hpp"
+#include "BiomeMap.hpp"
 #include "BlocksManager.hpp"
+#include "ChunkState.hpp"
+#include "SectionConnectivity.hpp"
 #include "Voxel.hpp"
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <cstdint>
 #include <memory>
 #include <vector>
 
+// Диапазон высот [minY, maxY), в котором есть грани меша
+struct VerticalBounds {
+  int minY;
+  int maxY;
+
+  inline bool isEmpty() const noexcept { return minY >= maxY; }
+};
+
 class Chunk {
   friend class WorldGenerator;
 
 public:
+  static constexpr int SECTIONS_COUNT = 16;
+
+  // Данные меша по секциям высотой SECTION_SIZE: связность граней для отсечения пещер
+  // и диапазоны индексов, чтобы рисовать только видимые секции
+  struct MeshSections {
+    std::array<uint16_t, SECTIONS_COUNT> connectivity;
+    // Индексы секции s - [indexOffsets[s], indexOffsets[s + 1])
+    std::array<uint32_t, SECTIONS_COUNT + 1> indexOffsets;
+  };
+
+  // Где владелец держит чанк: его расход памяти учитывается в счётчике этого места
+  enum class MemoryAccount : uint8_t { None, Grid, Cache };
+  // Чанки сами докладывают в счётчик изменения своего расхода, владельцу не нужно их обходить
+  struct MemoryCounter {
+    // Может на мгновение уйти в минус, пока смена счётчика чанка обгоняет его же обновление расхода
+    std::atomic_int64_t bytes = 0;
+    std::atomic_int64_t chunks = 0;
+
+    inline size_t getBytes() const noexcept { return static_cast<size_t>(std::max<int64_t>(0, bytes.load())); }
+    inline size_t getChunks() const noexcept { return static_cast<size_t>(std::max<int64_t>(0, chunks.load())); }
+  };
+  struct MemoryCounters {
+    MemoryCounter grid;
+    MemoryCounter cache;
+  };
+
   Chunk(BlocksManager &blocksManager, int x, int z);
   Chunk(const Chunk &) = delete;
   Chunk(Chunk &&) = delete;
+  ~Chunk();
 
   inline int x() const noexcept { return m_x; }
   inline int z() const noexcept { return m_z; }
@@ -52,14 +92,47 @@ public:
     }
   };
 
-  inline bool isModified() const noexcept { return m_isModified; };
-  inline void setIsModified(bool isModified) noexcept { m_isModified = isModified; };
-  inline bool isMeshOutdated() const noexcept { return m_isMeshOutdated; };
+  inline ChunkState getState() const noexcept { return m_state.load(std::memory_order_acquire); }
+  // Переход выполняется, только если чанк сейчас в состоянии from
+  bool tryTransition(ChunkState from, ChunkState to) noexcept;
+  void markEvicting() noexcept;
+  // Увеличивает версию: результаты мешинга и загрузки, начатые до этого, считаются устаревшими.
+  // Возвращает true, если чанку теперь нужен новый мешинг.
+  bool markDirty() noexcept;
+  inline uint32_t getVersion() const noexcept { return m_version.load(std::memory_order_acquire); }
+  inline bool hasMesh() const noexcept { return m_hasMesh; }
+  // Границы загруженного меша; пока меша нет - вся высота чанка
+  inline VerticalBounds getMeshBounds() const noexcept {
+    const uint32_t packed = m_meshBounds.load(std::memory_order_acquire);
+    return {static_cast<int>(packed & 0xFFFFu), static_cast<int>(packed >> 16)};
+  }
+  // Секции загруженного меша; nullptr, пока меша нет
+  inline std::shared_ptr<const MeshSections> getMeshSections() const noexcept {
+    return m_meshSections.load(std::memory_order_acquire);
+  }
+  // Стороны, где при последнем мешинге не было соседа: грани на этой границе построены как открытые
+  inline uint8_t getMissingNeighbors() const noexcept { return m_missingNeighbors.load(std::memory_order_acquire); }
+  static int getStateCount(ChunkState state) noexcept;
+  // Вокселы, ещё не загруженный меш и меш на GPU, в байтах
+  inline size_t getMemoryUsage() const noexcept {
+    return m_memoryUsage.load(std::memory_order_relaxed) & MEMORY_USAGE_MASK;
+  }
+  // Переносит расход чанка в счётчик account, None - убирает из всех. counters запоминаются при первом вызове,
+  // который должен быть до того, как чанк увидят другие потоки
+  void setMemoryAccount(const std::shared_ptr<MemoryCounters> &counters, MemoryAccount account) noexcept;
+
+  inline const BiomeMap &getBiomeMap() const noexcept { return m_biomeMap; }
 
   inline std::shared_ptr<Mesh<ChunkVertex>> &getMesh() noexcept { return m_mesh; }
-  void generateVerticesAndIndices(std::shared_ptr<Chunk> front, std::shared_ptr<Chunk> back,
+  // Generated -> Meshing -> MeshReady. Возвращает false, если чанк не в Generated или результат устарел
+  // (тогда чанк возвращается в Generated).
+  bool generateVerticesAndIndices(std::shared_ptr<Chunk> front, std::shared_ptr<Chunk> back,
                                   std::shared_ptr<Chunk> left, std::shared_ptr<Chunk> right);
-  void generateMesh(RenderDeviceVk *device);
+  // MeshReady -> Uploading -> Resident, либо Generated, если пока шла загрузка чанк изменился.
+  // Возвращает размер загруженного меша в байтах, 0 - если чанк не в MeshReady или результат отброшен.
+  // Меш выделяется в общей арене мешей чанков. Без арены (бенчмарк без Vulkan) меш не создаётся,
+  // но переходы состояний те же.
+  size_t generateMesh(MeshArena *arena);
 
 public:
   static constexpr int CHUNK_SIZE = 16;
@@ -68,8 +141,20 @@ public:
   static constexpr int CHUNK_VOLUME = CHUNK_SIZE * CHUNK_SIZE * CHUNK_HEIGHT;
   static constexpr int LAST_BLOCK_IDX = CHUNK_SIZE - 1;
   static constexpr int HIGHEST_BLOCK_IDX = CHUNK_HEIGHT - 1;
+  static constexpr int SECTION_SIZE = 16;
+  static_assert(SECTIONS_COUNT * SECTION_SIZE == CHUNK_HEIGHT && SECTION_SIZE == CHUNK_SIZE);
+  // Биты getMissingNeighbors
+  static constexpr uint8_t FRONT_NEIGHBOR = 1 << 0;
+  static constexpr uint8_t BACK_NEIGHBOR = 1 << 1;
+  static constexpr uint8_t LEFT_NEIGHBOR = 1 << 2;
+  static constexpr uint8_t RIGHT_NEIGHBOR = 1 << 3;
+  static_assert(BiomeMap::SIZE == CHUNK_SIZE);
 
 private:
+  // Старшие биты m_memoryUsage - счётчик, в котором сейчас учтён чанк
+  static constexpr int MEMORY_ACCOUNT_SHIFT = 62;
+  static constexpr size_t MEMORY_USAGE_MASK = (size_t{1} << MEMORY_ACCOUNT_SHIFT) - 1;
+
   void addFrontFace(int x, int y, int z, float textureIdx);
   void addBackFace(int x, int y, int z, float textureIdx);
   void addLeftFace(int x, int y, int z, float textureIdx);
@@ -99,6 +184,13 @@ private:
     return !block.isOpaque();
   };
   void shrinkAirBlocks();
+  // Заливка по прозрачным вокселям секции: грани, достижимые из одной области, связаны
+  uint16_t computeSectionConnectivity(int section) const;
+  // Вызывающий должен владеть чанком через состояние Meshing или Uploading
+  void updateMemoryUsage() noexcept;
+  // Заменяет биты вне keepMask на bits одним обменом и переносит разницу в счётчики, действовавшие до и после него
+  void exchangeMemoryUsage(size_t keepMask, size_t bits) noexcept;
+  MemoryCounter *getMemoryCounter(MemoryAccount account) const noexcept;
   inline void updateMaxY() noexcept { m_maxY = (static_cast<int>(m_voxels.size()) / CHUNK_SQ_SIZE) - 1; };
 
 private:
@@ -106,15 +198,27 @@ private:
   int m_z;
   int m_worldX;
   int m_worldZ;
-  bool m_isModified = true;
-  bool m_isMeshOutdated = true;
+  std::atomic<ChunkState> m_state = ChunkState::Generating;
+  std::atomic_uint32_t m_version = 0;
+  // Версия, из которой построены m_vertices
+  uint32_t m_verticesVersion = 0;
+  VerticalBounds m_verticesBounds = {0, 0};
+  // minY в младших 16 битах, maxY в старших, чтобы читать обе границы атомарно
+  std::atomic_uint32_t m_meshBounds = static_cast<uint32_t>(CHUNK_HEIGHT) << 16;
+  std::shared_ptr<const MeshSections> m_verticesSections;
+  std::atomic<std::shared_ptr<const MeshSections>> m_meshSections;
+  std::atomic_bool m_hasMesh = false;
+  std::atomic_uint8_t m_missingNeighbors = 0;
+  // Расход в байтах и MemoryAccount в старших битах, чтобы обновление и смена счётчика не теряли друг друга
+  std::atomic_size_t m_memoryUsage = 0;
+  std::shared_ptr<MemoryCounters> m_memoryCounters;
   int m_maxY = 0;
   BlocksManager &m_blocksManager;
 
   std::vector<Voxel> m_voxels;
+  BiomeMap m_biomeMap;
 
   std::vector<ChunkVertex> m_vertices;
   std::vector<uint32_t> m_indices;
   std::shared_ptr<Mesh<ChunkVertex>> m_mesh;
-  std::atomic_bool m_isLocked;
 };
\ No newline at end of file
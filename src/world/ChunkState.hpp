@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Generating -> Generated -> Meshing -> MeshReady -> Uploading -> Resident.
+// Изменение чанка или соседа возвращает Resident в Generated. Из любого состояния можно перейти в Evicting.
+enum class ChunkState : uint8_t {
+  Generating,
+  Generated,
+  Meshing,
+  MeshReady,
+  Uploading,
+  Resident,
+  Evicting,
+  Count
+};
+
+constexpr size_t CHUNK_STATES_COUNT = static_cast<size_t>(ChunkState::Count);
+
+inline const char *toString(ChunkState state) noexcept {
+  switch (state) {
+  case ChunkState::Generating:
+    return "Generating";
+  case ChunkState::Generated:
+    return "Generated";
+  case ChunkState::Meshing:
+    return "Meshing";
+  case ChunkState::MeshReady:
+    return "MeshReady";
+  case ChunkState::Uploading:
+    return "Uploading";
+  case ChunkState::Resident:
+    return "Resident";
+  case ChunkState::Evicting:
+    return "Evicting";
+  default:
+    return "Unknown";
+  }
+}
@@ -0,0 +1,60 @@
+#include "ChunkUploadQueue.hpp"
+#include <algorithm>
+#include <chrono>
+#include <tracy/Tracy.hpp>
+#include <vector>
+
+void ChunkUploadQueue::push(const std::shared_ptr<Chunk> &chunk) {
+  ZoneScoped;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // Адрес мог остаться от уже удалённого чанка, поэтому перезаписываем
+  m_chunks.insert_or_assign(chunk.get(), chunk);
+}
+
+ChunkUploadQueue::Stats ChunkUploadQueue::drain(int playerX, int playerZ, const Budget &budget,
+                                                const Uploader &upload) {
+  ZoneScoped;
+  const auto startTime = std::chrono::steady_clock::now();
+  std::vector<std::shared_ptr<Chunk>> chunks;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    chunks.reserve(m_chunks.size());
+    for (auto &[key, weakChunk] : m_chunks) {
+      if (auto chunk = weakChunk.lock()) {
+        chunks.push_back(std::move(chunk));
+      }
+    }
+    m_chunks.clear();
+  }
+
+  auto getDistanceSq = [playerX, playerZ](const Chunk &chunk) {
+    const int dx = chunk.x() - playerX;
+    const int dz = chunk.z() - playerZ;
+    return dx * dx + dz * dz;
+  };
+  std::sort(chunks.begin(), chunks.end(),
+            [&](const auto &a, const auto &b) { return getDistanceSq(*a) < getDistanceSq(*b); });
+
+  Stats stats = {.uploadedChunks = 0, .uploadedBytes = 0, .pendingChunks = 0};
+  size_t idx = 0;
+  for (; idx < chunks.size(); idx++) {
+    const std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    const bool isBudgetExceeded = stats.uploadedBytes >= budget.maxBytes || elapsed.count() >= budget.maxMilliseconds;
+    if (stats.uploadedChunks > 0 && isBudgetExceeded) {
+      break;
+    }
+    const size_t bytes = upload(*chunks[idx]);
+    if (bytes > 0) {
+      stats.uploadedChunks++;
+      stats.uploadedBytes += bytes;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (; idx < chunks.size(); idx++) {
+    // Чанк мог быть перемешан и добавлен снова, пока мы загружали остальные
+    m_chunks.try_emplace(chunks[idx].get(), chunks[idx]);
+  }
+  stats.pendingChunks = m_chunks.size();
+  return stats;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Chunk.hpp"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Чанки с готовыми вершинами, ожидающие загрузки меша на GPU.
+// Мешинг кладёт чанки из воркеров, поток рендера забирает ближайшие к игроку в пределах бюджета кадра.
+class ChunkUploadQueue {
+public:
+  struct Budget {
+    size_t maxBytes;
+    float maxMilliseconds;
+  };
+  struct Stats {
+    size_t uploadedChunks;
+    size_t uploadedBytes;
+    size_t pendingChunks;
+  };
+  // Возвращает число загруженных байт, 0 - если загружать было нечего
+  using Uploader = std::function<size_t(Chunk &)>;
+
+  void push(const std::shared_ptr<Chunk> &chunk);
+  // Хотя бы один чанк загружается всегда, чтобы очередь двигалась при любом бюджете
+  Stats drain(int playerX, int playerZ, const Budget &budget, const Uploader &upload);
+
+  inline size_t size() noexcept {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_chunks.size();
+  }
+
+private:
+  std::mutex m_mutex;
+  // weak_ptr: выгруженный из мира чанк не должен удерживаться очередью
+  std::unordered_map<const Chunk *, std::weak_ptr<Chunk>> m_chunks;
+};
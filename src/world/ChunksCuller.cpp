@@ -0,0 +1,217 @@
+#include "ChunksCuller.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <tracy/Tracy.hpp>
+
+void ChunksTile::expandBounds(VerticalBounds bounds) noexcept {
+  uint32_t packed = packedBounds.load(std::memory_order_relaxed);
+  while (true) {
+    VerticalBounds expanded = {static_cast<int>(packed & 0xFFFFu), static_cast<int>(packed >> 16)};
+    if (expanded.isEmpty()) {
+      expanded = bounds;
+    } else {
+      expanded.minY = std::min(expanded.minY, bounds.minY);
+      expanded.maxY = std::max(expanded.maxY, bounds.maxY);
+    }
+    const uint32_t desired =
+        static_cast<uint32_t>(expanded.minY) | (static_cast<uint32_t>(expanded.maxY) << 16);
+    if (desired == packed ||
+        packedBounds.compare_exchange_weak(packed, desired, std::memory_order_release, std::memory_order_relaxed)) {
+      return;
+    }
+  }
+}
+
+ChunksCuller::RenderList ChunksCuller::cull(const ChunksSnapshot &snapshot, const Frustum &frustum,
+                                            const glm::vec3 &cameraPosition, int playerX, int playerZ,
+                                            const Budget &budget) {
+  ZoneScoped;
+  const auto cullingStart = std::chrono::steady_clock::now();
+  const auto deadline = cullingStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                           std::chrono::duration<float, std::milli>(budget.maxMilliseconds));
+  m_stats = {};
+  RenderList renderList;
+  if (snapshot.tiles.empty()) {
+    return renderList;
+  }
+  m_frame++;
+  const size_t gridSize = static_cast<size_t>(snapshot.getSideSize() * snapshot.getSideSize());
+  m_sections.resize(gridSize);
+  m_sectionsFrames.resize(gridSize);
+  // Боксы в координатах относительно чанка игрока
+  auto toRelative = [&](int x, int y, int z) {
+    return glm::vec3((x - playerX) * Chunk::CHUNK_SIZE, y, (z - playerZ) * Chunk::CHUNK_SIZE);
+  };
+
+  // Невидимый тайл отбрасывает все свои чанки одной проверкой, целиком видимый принимает их без проверок
+  m_tilesCuller.clear();
+  m_tilesToCull.clear();
+  for (const auto &tile : snapshot.tiles) {
+    const VerticalBounds bounds = tile->getBounds();
+    if (bounds.isEmpty()) {
+      continue;
+    }
+    m_tilesCuller.addBox(toRelative(tile->minX, bounds.minY, tile->minZ),
+                         toRelative(tile->maxX + 1, bounds.maxY, tile->maxZ + 1));
+    m_tilesToCull.push_back(tile.get());
+  }
+  m_tilesCuller.cull(frustum, m_visibleBoxes);
+
+  m_culler.clear();
+  m_boxChunks.clear();
+  m_visibleChunks.clear();
+  for (const uint32_t box : m_visibleBoxes) {
+    const ChunksTile &tile = *m_tilesToCull[box];
+    const VerticalBounds tileBounds = tile.getBounds();
+    const bool isTileInside =
+        FrustumCuller::isBoxInside(frustum, toRelative(tile.minX, tileBounds.minY, tile.minZ),
+                                   toRelative(tile.maxX + 1, tileBounds.maxY, tile.maxZ + 1));
+    for (int z = tile.minZ; z <= tile.maxZ; z++) {
+      for (int x = tile.minX; x <= tile.maxX; x++) {
+        if (isTileInside) {
+          m_visibleChunks.emplace_back(x, z);
+          continue;
+        }
+        // Пустое небо над рельефом не делает чанк видимым. Для дыр берём всю высоту: рельеф ещё неизвестен.
+        const auto &chunk = tile.getChunk(x, z);
+        const VerticalBounds bounds = chunk ? chunk->getMeshBounds() : VerticalBounds{0, Chunk::CHUNK_HEIGHT};
+        m_culler.addBox(toRelative(x, bounds.minY, z), toRelative(x + 1, bounds.maxY, z + 1));
+        m_boxChunks.emplace_back(x, z);
+      }
+    }
+  }
+  m_culler.cull(frustum, m_visibleBoxes);
+  for (const uint32_t box : m_visibleBoxes) {
+    m_visibleChunks.push_back(m_boxChunks[box]);
+  }
+
+  // Список рендера идёт от ближних колец к дальним: сортировка подсчётом по номеру кольца
+  auto getRing = [&](const glm::ivec2 &position) {
+    return static_cast<size_t>(std::max(std::abs(position.x - playerX), std::abs(position.y - playerZ)));
+  };
+  m_ringCounts.assign(static_cast<size_t>(snapshot.loadRadius) * 2 + 2, 0);
+  for (const auto &position : m_visibleChunks) {
+    m_ringCounts[std::min(getRing(position) + 1, m_ringCounts.size() - 1)]++;
+  }
+  for (size_t ring = 1; ring < m_ringCounts.size(); ring++) {
+    m_ringCounts[ring] += m_ringCounts[ring - 1];
+  }
+  m_renderOrder.resize(m_visibleChunks.size());
+  for (const auto &position : m_visibleChunks) {
+    m_renderOrder[m_ringCounts[std::min(getRing(position), m_ringCounts.size() - 2)]++] = position;
+  }
+
+  const bool isWalkComplete = findVisibleSections(snapshot, frustum, cameraPosition, playerX, playerZ, deadline);
+  m_stats.isSectionsWalkInterrupted = !isWalkComplete;
+
+  renderList.chunks.reserve(m_renderOrder.size());
+  renderList.visibleSections.reserve(m_renderOrder.size());
+  size_t holesCount = 0;
+  for (const auto &position : m_renderOrder) {
+    const int x = position.x;
+    const int z = position.y;
+    const auto &chunk = snapshot.getChunk(x, z);
+    if (!chunk || !chunk->hasMesh()) {
+      holesCount++;
+    }
+    if (!chunk) {
+      continue;
+    }
+    const size_t index = snapshot.getChunkIdx(x, z);
+    const uint16_t visibleSections = isWalkComplete ? m_visibleSectionMasks[index] : 0xFFFF;
+    if (visibleSections != 0xFFFF) {
+      if (const auto &sections = getSections(snapshot, x, z, index)) {
+        for (int section = 0; section < Chunk::SECTIONS_COUNT; section++) {
+          const bool hasGeometry = sections->indexOffsets[section + 1] > sections->indexOffsets[section];
+          if (hasGeometry && !(visibleSections & (1u << section))) {
+            m_stats.caveCulledSections++;
+          }
+        }
+      }
+    }
+    if (visibleSections == 0 && chunk->hasMesh()) {
+      continue;
+    }
+    renderList.chunks.push_back(chunk);
+    renderList.visibleSections.push_back(visibleSections);
+  }
+
+  const size_t visibleCount = m_renderOrder.size();
+  m_stats.holesOnScreen =
+      visibleCount > 0 ? static_cast<float>(holesCount) / static_cast<float>(visibleCount) : 0.0f;
+  m_stats.microseconds =
+      std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - cullingStart).count();
+  return renderList;
+}
+
+const std::shared_ptr<const Chunk::MeshSections> &ChunksCuller::getSections(const ChunksSnapshot &snapshot, int x,
+                                                                            int z, size_t index) {
+  if (m_sectionsFrames[index] != m_frame) {
+    m_sectionsFrames[index] = m_frame;
+    const auto &chunk = snapshot.getChunk(x, z);
+    m_sections[index] = chunk ? chunk->getMeshSections() : nullptr;
+  }
+  return m_sections[index];
+}
+
+bool ChunksCuller::findVisibleSections(const ChunksSnapshot &snapshot, const Frustum &frustum,
+                                       const glm::vec3 &cameraPosition, int playerX, int playerZ,
+                                       std::chrono::steady_clock::time_point deadline) {
+  ZoneScoped;
+  const size_t gridSize = static_cast<size_t>(snapshot.getSideSize() * snapshot.getSideSize());
+  m_visibleSectionMasks.assign(gridSize, 0);
+  const int cameraSection = static_cast<int>(std::floor(cameraPosition.y / Chunk::SECTION_SIZE));
+  // Камера над или под миром: обход не с чего начать, показываем всё, что в пирамиде
+  if (cameraSection < 0 || cameraSection >= Chunk::SECTIONS_COUNT || !snapshot.isInLoadRadius(playerX, playerZ)) {
+    std::fill(m_visibleSectionMasks.begin(), m_visibleSectionMasks.end(), static_cast<uint16_t>(0xFFFF));
+    return true;
+  }
+
+  // Отметки не очищаются: посещённой считается секция с номером текущего кадра
+  m_visitedSections.resize(gridSize * Chunk::SECTIONS_COUNT);
+  m_sectionsQueue.clear();
+  m_sectionsQueue.push_back({playerX, cameraSection, playerZ, NO_FACE, 0});
+  m_visitedSections[snapshot.getChunkIdx(playerX, playerZ) * Chunk::SECTIONS_COUNT + cameraSection] = m_frame;
+
+  for (size_t head = 0; head < m_sectionsQueue.size(); head++) {
+    if (head % BUDGET_CHECK_INTERVAL == BUDGET_CHECK_INTERVAL - 1 && std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    const SectionNode node = m_sectionsQueue[head];
+    const size_t chunkIdx = snapshot.getChunkIdx(node.x, node.z);
+    m_visibleSectionMasks[chunkIdx] |= static_cast<uint16_t>(1u << node.y);
+    // Чанк без меша ещё не знает своих пустот, считаем его прозрачным, чтобы не скрыть лишнего
+    const auto &sections = getSections(snapshot, node.x, node.z, chunkIdx);
+    const uint16_t connectivity = sections ? sections->connectivity[node.y] : SectionConnectivity::ALL_CONNECTED;
+
+    for (int face = 0; face < SectionConnectivity::FACES_COUNT; face++) {
+      if (node.directions & (1u << SectionConnectivity::getOpposite(face))) {
+        continue;
+      }
+      if (node.entryFace != NO_FACE && !SectionConnectivity::isConnected(connectivity, node.entryFace, face)) {
+        continue;
+      }
+      const auto &direction = SectionConnectivity::FACE_DIRECTIONS[face];
+      const int x = node.x + direction[0];
+      const int y = node.y + direction[1];
+      const int z = node.z + direction[2];
+      if (y < 0 || y >= Chunk::SECTIONS_COUNT || !snapshot.isInLoadRadius(x, z)) {
+        continue;
+      }
+      auto &visited = m_visitedSections[snapshot.getChunkIdx(x, z) * Chunk::SECTIONS_COUNT + y];
+      if (visited == m_frame) {
+        continue;
+      }
+      const glm::vec3 min((x - playerX) * Chunk::CHUNK_SIZE, y * Chunk::SECTION_SIZE,
+                          (z - playerZ) * Chunk::CHUNK_SIZE);
+      if (!FrustumCuller::isBoxVisible(frustum, min, min + glm::vec3(Chunk::SECTION_SIZE))) {
+        continue;
+      }
+      visited = m_frame;
+      m_sectionsQueue.push_back({x, y, z, static_cast<uint8_t>(SectionConnectivity::getOpposite(face)),
+                                 static_cast<uint8_t>(node.directions | (1u << face))});
+    }
+  }
+  return true;
+}
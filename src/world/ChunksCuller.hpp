@@ -0,0 +1,154 @@
+#pragma once
+
+#include "../core/Frustum.hpp"
+#include "../core/FrustumCuller.hpp"
+#include "Chunk.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+// Группа SIZE x SIZE чанков, выровненная по миру и обрезанная радиусом загрузки.
+// После публикации не меняется, кроме высоты: загрузка меша может расширить её до пересборки тайла.
+struct ChunksTile {
+  static constexpr int SIZE = 8;
+
+  int minX = 0;
+  int maxX = -1;
+  int minZ = 0;
+  int maxZ = -1;
+  // По строкам от (minX, minZ); nullptr - позиция ещё не загружена
+  std::vector<std::shared_ptr<Chunk>> chunks;
+  // Объединение границ мешей дочерних чанков: minY в младших 16 битах, maxY в старших
+  std::atomic_uint32_t packedBounds = 0;
+
+  inline static int toTilePos(int x) noexcept {
+    if (x >= 0) {
+      return x / SIZE;
+    }
+    return (x - SIZE + 1) / SIZE;
+  }
+  inline bool contains(int x, int z) const noexcept { return x >= minX && x <= maxX && z >= minZ && z <= maxZ; }
+  inline const std::shared_ptr<Chunk> &getChunk(int x, int z) const noexcept {
+    return chunks[static_cast<size_t>((z - minZ) * (maxX - minX + 1) + (x - minX))];
+  }
+  inline VerticalBounds getBounds() const noexcept {
+    const uint32_t packed = packedBounds.load(std::memory_order_acquire);
+    return {static_cast<int>(packed & 0xFFFFu), static_cast<int>(packed >> 16)};
+  }
+  inline void setBounds(VerticalBounds bounds) noexcept {
+    packedBounds.store(static_cast<uint32_t>(bounds.minY) | (static_cast<uint32_t>(bounds.maxY) << 16),
+                       std::memory_order_release);
+  }
+  // Безопасно из любого потока: границы только растут
+  void expandBounds(VerticalBounds bounds) noexcept;
+};
+
+// Срез сетки чанков, который менеджер публикует для отсечения в потоке рендера.
+// Не меняется после публикации; неизменные тайлы переходят в следующий срез без копирования.
+struct ChunksSnapshot {
+  int centerX = 0;
+  int centerZ = 0;
+  int loadRadius = -1;
+  int minTileX = 0;
+  int minTileZ = 0;
+  int tilesCountX = 0;
+  int tilesCountZ = 0;
+  // По строкам от (minTileX, minTileZ), без пропусков: каждый тайл диапазона пересекает радиус
+  std::vector<std::shared_ptr<ChunksTile>> tiles;
+
+  inline int getSideSize() const noexcept { return loadRadius * 2 + 1; }
+  inline bool isInLoadRadius(int x, int z) const noexcept {
+    return x >= centerX - loadRadius && x <= centerX + loadRadius && z >= centerZ - loadRadius &&
+           z <= centerZ + loadRadius;
+  }
+  // Индекс позиции в квадрате радиуса загрузки, позиция должна быть в радиусе
+  inline size_t getChunkIdx(int x, int z) const noexcept {
+    return static_cast<size_t>((x - centerX + loadRadius) + (z - centerZ + loadRadius) * getSideSize());
+  }
+  // nullptr, если тайл вне радиуса
+  inline ChunksTile *findTile(int x, int z) const noexcept {
+    const int tileX = ChunksTile::toTilePos(x) - minTileX;
+    const int tileZ = ChunksTile::toTilePos(z) - minTileZ;
+    if (tileX < 0 || tileX >= tilesCountX || tileZ < 0 || tileZ >= tilesCountZ) {
+      return nullptr;
+    }
+    ChunksTile *tile = tiles[static_cast<size_t>(tileX + tileZ * tilesCountX)].get();
+    return tile->contains(x, z) ? tile : nullptr;
+  }
+  // Позиция должна быть в радиусе
+  inline const std::shared_ptr<Chunk> &getChunk(int x, int z) const noexcept {
+    return findTile(x, z)->getChunk(x, z);
+  }
+};
+
+// Отсечение чанков в потоке рендера по камере текущего кадра.
+// Тайлы отсекаются целиком, чанки - только в частично видимых тайлах, затем обход секций от камеры
+// скрывает пещеры. Обход прерывается по бюджету кадра, тогда секции кадра не отсекаются.
+class ChunksCuller {
+public:
+  struct RenderList {
+    std::vector<std::shared_ptr<Chunk>> chunks;
+    // Бит на секцию: что из чанка chunks[i] видно с камеры через пустоты соседних секций
+    std::vector<uint16_t> visibleSections;
+  };
+  struct Budget {
+    float maxMilliseconds;
+  };
+  struct Stats {
+    float microseconds;
+    // Доля видимых позиций сетки без загруженного меша, от 0 до 1
+    float holesOnScreen;
+    // Непустые секции в пирамиде видимости, скрытые отсечением пещер
+    size_t caveCulledSections;
+    // Обход секций не уложился в бюджет
+    bool isSectionsWalkInterrupted;
+  };
+
+  // frustum и cameraPosition - в координатах относительно чанка (playerX, playerZ)
+  RenderList cull(const ChunksSnapshot &snapshot, const Frustum &frustum, const glm::vec3 &cameraPosition,
+                  int playerX, int playerZ, const Budget &budget);
+  inline const Stats &getStats() const noexcept { return m_stats; }
+
+private:
+  // Обход в ширину по секциям от секции камеры: в соседа идём, только если грань входа и грань выхода
+  // связаны пустотой и не поворачиваем назад к камере. Заполняет m_visibleSectionMasks.
+  // Возвращает false, если обход прерван по бюджету
+  bool findVisibleSections(const ChunksSnapshot &snapshot, const Frustum &frustum, const glm::vec3 &cameraPosition,
+                           int playerX, int playerZ, std::chrono::steady_clock::time_point deadline);
+  // Секции меша читаются один раз за кадр и только для чанков, которых коснулся обход
+  const std::shared_ptr<const Chunk::MeshSections> &getSections(const ChunksSnapshot &snapshot, int x, int z,
+                                                                size_t index);
+
+  struct SectionNode {
+    int x;
+    int y;
+    int z;
+    uint8_t entryFace;
+    // Направления, по которым уже шли от камеры
+    uint8_t directions;
+  };
+  static constexpr uint8_t NO_FACE = 0xFF;
+  // Часы опрашиваются раз в столько секций обхода
+  static constexpr size_t BUDGET_CHECK_INTERVAL = 256;
+
+  Stats m_stats = {};
+  FrustumCuller m_tilesCuller;
+  std::vector<const ChunksTile *> m_tilesToCull;
+  FrustumCuller m_culler;
+  std::vector<glm::ivec2> m_boxChunks;
+  std::vector<uint32_t> m_visibleBoxes;
+  std::vector<glm::ivec2> m_visibleChunks;
+  std::vector<size_t> m_ringCounts;
+  std::vector<glm::ivec2> m_renderOrder;
+  // Номер кадра: отметки обхода и прочитанные секции с другим номером считаются устаревшими
+  uint32_t m_frame = 0;
+  std::vector<uint16_t> m_visibleSectionMasks;
+  std::vector<uint32_t> m_visitedSections;
+  std::vector<SectionNode> m_sectionsQueue;
+  std::vector<std::shared_ptr<const Chunk::MeshSections>> m_sections;
+  std::vector<uint32_t> m_sectionsFrames;
+};
@@ -1,118 +1,419 @@
 #include "ChunksManager.hpp"
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <cstddef>
-#include <future>
 #include <memory>
 #include <mutex>
-#include <ranges>
 #include <shared_mutex>
 #include <tracy/Tracy.hpp>
 #include <tuple>
 #include <utility>
 #include <vector>
 
-ChunksManager::ChunksManager(BlocksManager &blocksManager, TextureAtlas &textureAtlas,
-                             PlayerController &playerController)
-    : m_blocksManager{blocksManager}, m_textureAtlas{textureAtlas}, m_worldGenerator{blocksManager},
-      m_playerController{playerController} {
+namespace {
+constexpr size_t BYTES_IN_MB = 1024 * 1024;
+} // namespace
+
+ChunksManager::ChunksManager(BlocksManager &blocksManager, PlayerController &playerController, const Config &config,
+                             StageListener stageListener)
+    : m_targetLoadRadius{std::clamp(config.renderDistance, MIN_LOAD_RADIUS, MAX_LOAD_RADIUS)},
+      m_memoryBudget{config.memoryBudgetMb * BYTES_IN_MB}, m_blocksManager{blocksManager},
+      m_playerController{playerController}, m_stageListener{std::move(stageListener)}, m_worldGenerator{blocksManager},
+      m_prefetchSeconds{std::max(0.0f, config.prefetchSeconds)}, m_isPrefetchMeshingEnabled{config.prefetchMeshing},
+      m_retentionDistance{std::max(0, config.retentionDistance)},
+      m_retentionTime{std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<float>(std::max(0.0f, config.retentionSeconds)))} {
   ZoneScoped;
   m_chunkLastMovedX = m_playerController.getChunkX();
   m_chunkLastMovedZ = m_playerController.getChunkZ();
-  m_chunks.resize(static_cast<size_t>(m_chunksVectorSideSize * m_chunksVectorSideSize));
+  m_notifiedPlayerX = m_chunkLastMovedX;
+  m_notifiedPlayerZ = m_chunkLastMovedZ;
+  m_loadRadius = m_targetLoadRadius.load();
+  m_effectiveLoadRadius.store(m_loadRadius);
+  m_chunks.resize(static_cast<size_t>(CHUNKS_GRID_SIDE_SIZE * CHUNKS_GRID_SIDE_SIZE));
   m_thread = std::thread([this]() { asyncProcessChunks(); });
 }
 
 ChunksManager::~ChunksManager() {
-  m_isRunning = false;
+  {
+    std::lock_guard<std::mutex> lock(m_eventsMutex);
+    m_isRunning = false;
+  }
+  m_eventsCondition.notify_one();
   m_thread.join();
 }
 
 void ChunksManager::asyncProcessChunks() {
   ZoneScoped;
-  while (m_isRunning) {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_eventsMutex);
+      auto hasEvents = [this]() { return !m_isRunning || m_hasEvents; };
+      if (m_nextCacheExpiry == std::chrono::steady_clock::time_point::max()) {
+        m_eventsCondition.wait(lock, hasEvents);
+      } else {
+        // Удерживаемые чанки надо выгрузить по истечении срока, даже если событий нет
+        m_eventsCondition.wait_until(lock, m_nextCacheExpiry, hasEvents);
+      }
+      if (!m_isRunning) {
+        return;
+      }
+      // Сбрасываем до обработки: события, пришедшие во время прохода, запустят следующий
+      m_hasEvents = false;
+    }
+
+    updateLoadRadius();
     moveChunks();
-    loadChunks();
+    updatePrefetchRegion();
+    if (m_isChunkCacheDirty || std::chrono::steady_clock::now() >= m_nextCacheExpiry) {
+      evictCachedChunks();
+    }
+    // Сначала разгружаем нижние стадии, чтобы освободить место для верхних
+    rebalanceStages();
     updateModifiedChunks();
-    updateChunksToRender();
+    loadChunks();
+    publishSnapshot();
+  }
+}
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(3));
+void ChunksManager::wakeUp() {
+  {
+    std::lock_guard<std::mutex> lock(m_eventsMutex);
+    m_hasEvents = true;
   }
+  m_eventsCondition.notify_one();
 }
 
-void ChunksManager::loadChunks() {
+void ChunksManager::updateView(const glm::vec3 &viewDirection) {
   ZoneScoped;
-  std::vector<std::future<void>> futures;
+  {
+    std::lock_guard<std::mutex> lock(m_viewMutex);
+    m_viewDirection = viewDirection;
+  }
+  if (glm::dot(viewDirection, m_notifiedViewDirection) >= REPRIORITIZE_COS_ANGLE) {
+    return;
+  }
+  m_notifiedViewDirection = viewDirection;
+  wakeUp();
+}
 
-  std::vector<std::tuple<int, int>> chunksToGenerate;
+void ChunksManager::notifyPlayerMoved() {
+  const int playerX = m_playerController.getChunkX();
+  const int playerZ = m_playerController.getChunkZ();
+  const glm::ivec2 prefetchOffset = getPrefetchOffset();
+  if (playerX == m_notifiedPlayerX && playerZ == m_notifiedPlayerZ && prefetchOffset == m_notifiedPrefetchOffset) {
+    return;
+  }
+  m_notifiedPlayerX = playerX;
+  m_notifiedPlayerZ = playerZ;
+  m_notifiedPrefetchOffset = prefetchOffset;
+  wakeUp();
+}
 
-  if (m_chunks[m_centerIdx] == nullptr) {
-    chunksToGenerate.push_back({m_chunkLastMovedX, m_chunkLastMovedZ});
+ChunkUploadQueue::Stats ChunksManager::uploadMeshes(const ChunkUploadQueue::Budget &budget,
+                                                    const ChunkUploadQueue::Uploader &upload) {
+  ZoneScoped;
+  const auto stats = m_uploadQueue.drain(m_playerController.getChunkX(), m_playerController.getChunkZ(), budget,
+                                         [&](Chunk &chunk) {
+                                           const size_t bytes = upload(chunk);
+                                           // Границы меша поменялись вместе с мешем. До пересборки тайла
+                                           // расширяем его в текущем срезе, чтобы чанк не пропал на кадр
+                                           markTileDirty(chunk.x(), chunk.z());
+                                           const VerticalBounds bounds = chunk.getMeshBounds();
+                                           if (const auto snapshot = getSnapshot(); snapshot && !bounds.isEmpty()) {
+                                             if (auto *tile = snapshot->findTile(chunk.x(), chunk.z())) {
+                                               tile->expandBounds(bounds);
+                                             }
+                                           }
+                                           // Чанк изменился, пока ждал загрузки
+                                           if (chunk.getState() == ChunkState::Generated) {
+                                             scheduleRemesh(chunk.x(), chunk.z());
+                                           }
+                                           return bytes;
+                                         });
+  if (stats.uploadedChunks > 0) {
+    // Публикуем срез с новыми границами тайлов
+    wakeUp();
   }
+  return stats;
+}
 
-  int radius = 1;
-  while (radius <= m_loadRadius && chunksToGenerate.size() < m_maxAsyncChunksLoading) {
-    int xStart = m_chunkLastMovedX - radius;
-    int xEnd = m_chunkLastMovedX + radius;
-    int zStart = m_chunkLastMovedZ - radius;
-    int zEnd = m_chunkLastMovedZ + radius;
+void ChunksManager::setLoadRadius(int radius) {
+  m_targetLoadRadius.store(std::clamp(radius, MIN_LOAD_RADIUS, MAX_LOAD_RADIUS));
+  wakeUp();
+}
 
-    for (int x = xStart; x <= xEnd; x++) {
-      if (chunksToGenerate.size() >= m_maxAsyncChunksLoading) {
-        break;
+void ChunksManager::setMemoryBudget(size_t bytes) {
+  m_memoryBudget.store(bytes);
+  wakeUp();
+}
+
+void ChunksManager::updateLoadRadius() {
+  ZoneScoped;
+  const size_t cacheUsage = m_memoryCounters->cache.getBytes();
+  const size_t usage = m_memoryCounters->grid.getBytes() + cacheUsage;
+  const size_t chunksCount = m_memoryCounters->grid.getChunks();
+
+  const int targetRadius = m_targetLoadRadius.load();
+  const size_t budget = m_memoryBudget.load();
+  int radius = m_loadRadius;
+  if (radius > targetRadius) {
+    radius = targetRadius;
+  } else if (budget > 0 && usage > budget && cacheUsage > 0) {
+    // Сначала жертвуем удерживаемыми и предзагруженными чанками, а не радиусом
+    m_isChunkCacheFlushRequested = true;
+    m_isChunkCacheDirty = true;
+    wakeUp();
+    return;
+  } else if (budget > 0 && usage > budget) {
+    radius = std::max(MIN_LOAD_RADIUS, radius - 1);
+  } else if (radius < targetRadius) {
+    // Оцениваем память следующего кольца по среднему размеру уже загруженных чанков
+    const size_t sideSize = static_cast<size_t>((radius + 1) * 2 + 1);
+    const size_t projectedUsage = chunksCount > 0 ? usage / chunksCount * sideSize * sideSize : 0;
+    if (budget == 0) {
+      radius = targetRadius;
+    } else if (projectedUsage <= static_cast<size_t>(static_cast<float>(budget) * MEMORY_BUDGET_GROW_THRESHOLD)) {
+      radius++;
+    }
+  }
+
+  if (radius != m_loadRadius) {
+    applyLoadRadius(radius);
+    // Радиус меняется на одно кольцо за проход, следующий проход проверит бюджет ещё раз
+    wakeUp();
+  }
+}
+
+void ChunksManager::applyLoadRadius(int radius) {
+  ZoneScoped;
+  {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_loadRadius = radius;
+    for (auto &chunk : m_chunks) {
+      if (chunk && !isInLoadRadius(chunk->x(), chunk->z())) {
+        auto droppedChunk = std::move(chunk);
+        droppedChunk->markEvicting();
+        droppedChunk->setMemoryAccount(m_memoryCounters, Chunk::MemoryAccount::None);
+        markNeighborsDirty(droppedChunk->x(), droppedChunk->z());
       }
-      if (!getChunkAt(x, zStart)) {
-        chunksToGenerate.push_back({x, zStart});
+    }
+    markGridDirty();
+  }
+  m_effectiveLoadRadius.store(radius);
+  m_isLoadQueueDirty = true;
+  m_isChunkCacheDirty = true;
+  cancelStaleJobs();
+  // Соседи на новой границе радиуса больше не ожидаются
+  releaseDeferredChunks();
+}
+
+glm::vec2 ChunksManager::getViewDirection2D() {
+  glm::vec3 viewDirection;
+  {
+    std::lock_guard<std::mutex> lock(m_viewMutex);
+    viewDirection = m_viewDirection;
+  }
+  const glm::vec2 direction(viewDirection.x, viewDirection.z);
+  const float length = glm::length(direction);
+  // Взгляд вертикально вниз или вверх - направление не влияет на приоритет
+  return length > 0.01f ? direction / length : glm::vec2(0.0f);
+}
+
+void ChunksManager::rebuildLoadQueue(const glm::vec2 &viewDirection) {
+  ZoneScoped;
+  m_loadQueue.clear();
+  std::shared_lock<std::shared_mutex> chunksLock(m_mutex);
+  std::lock_guard<std::mutex> jobsLock(m_jobsMutex);
+  for (int z = m_chunkLastMovedZ - m_loadRadius; z <= m_chunkLastMovedZ + m_loadRadius; z++) {
+    for (int x = m_chunkLastMovedX - m_loadRadius; x <= m_chunkLastMovedX + m_loadRadius; x++) {
+      if (!getChunkAtUnlocked(x, z) && !m_chunksInGeneration.contains(getChunkKey(x, z))) {
+        m_loadQueue.push_back({x, z, getChunkPriority(x, z, viewDirection)});
       }
-      if (!getChunkAt(x, zEnd)) {
-        chunksToGenerate.push_back({x, zEnd});
+    }
+  }
+  m_prefetchQueue.clear();
+  for (int z = m_prefetchMinZ; z <= m_prefetchMaxZ; z++) {
+    for (int x = m_prefetchMinX; x <= m_prefetchMaxX; x++) {
+      if (isInPrefetchRegion(x, z) && !getChunkAtUnlocked(x, z) && !m_chunksInGeneration.contains(getChunkKey(x, z))) {
+        m_prefetchQueue.push_back({x, z, getChunkPriority(x, z, viewDirection)});
       }
     }
-    for (int z = zStart + 1; z <= zEnd - 1; z++) {
-      if (chunksToGenerate.size() >= m_maxAsyncChunksLoading) {
+  }
+  auto byPriorityDescending = [](const ChunkRequest &a, const ChunkRequest &b) { return a.priority > b.priority; };
+  std::sort(m_loadQueue.begin(), m_loadQueue.end(), byPriorityDescending);
+  std::sort(m_prefetchQueue.begin(), m_prefetchQueue.end(), byPriorityDescending);
+  m_prioritizedViewDirection = viewDirection;
+  m_isLoadQueueDirty = false;
+}
+
+void ChunksManager::loadChunks() {
+  ZoneScoped;
+  const glm::vec2 viewDirection = getViewDirection2D();
+  if (glm::dot(viewDirection, m_prioritizedViewDirection) < REPRIORITIZE_COS_ANGLE) {
+    m_isLoadQueueDirty = true;
+  }
+  if (m_isLoadQueueDirty) {
+    rebuildLoadQueue(viewDirection);
+  }
+
+  std::vector<std::tuple<int, int, uint64_t>> chunksToGenerate;
+  {
+    std::shared_lock<std::shared_mutex> chunksLock(m_mutex);
+    std::lock_guard<std::mutex> jobsLock(m_jobsMutex);
+    // Очередь мешинга ограничена: если мешинг не успевает, генерация ждёт и не раздувает память под вокселы
+    auto canGenerate = [this]() {
+      const size_t inFlight = m_chunksInGeneration.size();
+      return static_cast<int>(inFlight) < m_generationSlots && inFlight + m_dirtyChunks.size() < MESH_QUEUE_CAPACITY;
+    };
+    while (canGenerate()) {
+      const bool isPrefetch = m_loadQueue.empty();
+      auto &queue = isPrefetch ? m_prefetchQueue : m_loadQueue;
+      if (queue.empty()) {
         break;
       }
-      if (!getChunkAt(xStart, z)) {
-        chunksToGenerate.push_back({xStart, z});
-      }
-      if (!getChunkAt(xEnd, z)) {
-        chunksToGenerate.push_back({xEnd, z});
+      const auto request = queue.back();
+      queue.pop_back();
+      const auto key = getChunkKey(request.x, request.z);
+      const bool isWanted = isPrefetch ? isInPrefetchRegion(request.x, request.z)
+                                       : isInLoadRadius(request.x, request.z);
+      if (!isWanted || getChunkAtUnlocked(request.x, request.z) || m_chunksInGeneration.contains(key)) {
+        continue;
       }
+      const auto requestId = m_nextRequestId++;
+      chunksToGenerate.push_back({request.x, request.z, requestId});
+      m_chunksInGeneration[key] = {nullptr, requestId};
     }
-    radius++;
   }
 
-  if (chunksToGenerate.size()) {
-    m_shouldUpdateChunksToRender.store(true);
+  if (chunksToGenerate.empty()) {
+    return;
+  }
+  std::lock_guard<std::mutex> jobsLock(m_jobsMutex);
+  for (const auto &[x, z, requestId] : chunksToGenerate) {
+    auto job = m_jobSystem.submit([this, x, z, requestId]() { generateChunk(x, z, requestId); });
+    if (auto it = m_chunksInGeneration.find(getChunkKey(x, z));
+        it != m_chunksInGeneration.end() && it->second.requestId == requestId) {
+      it->second.job = job;
+    }
   }
+}
 
-  for (auto chunksPositions : chunksToGenerate | std::ranges::views::chunk(MAX_CHUNKS_TO_LOAD_PER_THREAD)) {
-    futures.emplace_back(std::async(std::launch::async, [this, chunksPositions]() {
-      for (auto &chunkPos : chunksPositions) {
-        const auto x = std::get<0>(chunkPos);
-        const auto z = std::get<1>(chunkPos);
-        auto chunk = m_worldGenerator.generateChunk(x, z);
-        this->insertChunk(chunk);
+void ChunksManager::rebalanceStages() {
+  ZoneScoped;
+  const size_t uploadQueueDepth = m_uploadQueue.size();
+  PipelineStats stats;
+  {
+    std::lock_guard<std::mutex> lock(m_jobsMutex);
+    const size_t meshQueueDepth = m_dirtyChunks.size();
+    const size_t meshDeferred = m_deferredChunks.size();
+    const bool hasChunksToGenerate = !m_loadQueue.empty() || !m_prefetchQueue.empty();
+    // Мешинг - узкое место: очередь перед ним растёт, а загрузка на GPU успевает
+    if (meshQueueDepth > MESH_QUEUE_CAPACITY / 2 && uploadQueueDepth < UPLOAD_QUEUE_CAPACITY &&
+        m_generationSlots > 1) {
+      m_generationSlots--;
+      m_meshingSlots++;
+    } else if (meshQueueDepth < MESH_QUEUE_CAPACITY / 4 && hasChunksToGenerate && m_meshingSlots > 1) {
+      m_generationSlots++;
+      m_meshingSlots--;
+    }
+    stats = {
+        .generating = m_chunksInGeneration.size(),
+        .meshQueueDepth = meshQueueDepth,
+        .meshDeferred = meshDeferred,
+        .meshing = m_chunksInMeshing.size(),
+        .uploadQueueDepth = uploadQueueDepth,
+        .generationSlots = m_generationSlots,
+        .meshingSlots = m_meshingSlots,
+    };
+  }
+  std::lock_guard<std::mutex> lock(m_statsMutex);
+  m_pipelineStats = stats;
+}
+
+void ChunksManager::cancelStaleJobs() {
+  ZoneScoped;
+  std::lock_guard<std::mutex> lock(m_jobsMutex);
+  for (auto *jobs : {&m_chunksInGeneration, &m_chunksInMeshing}) {
+    std::erase_if(*jobs, [this](const auto &entry) {
+      const int x = static_cast<int32_t>(entry.first >> 32);
+      const int z = static_cast<int32_t>(entry.first & 0xFFFFFFFFu);
+      if (isInLoadRadius(x, z) || isInPrefetchRegion(x, z)) {
+        return false;
+      }
+      if (entry.second.job) {
+        entry.second.job->cancel();
       }
-    }));
+      return true;
+    });
   }
+}
 
-  for (auto &fut : futures) {
-    fut.get();
+void ChunksManager::generateChunk(int x, int z, uint64_t requestId) {
+  ZoneScoped;
+  auto chunk = m_worldGenerator.generateChunk(x, z);
+  insertChunk(chunk);
+  if (m_stageListener) {
+    m_stageListener(x, z, ChunkState::Generated);
+  }
+  // Дальше чанк ждёт мешинга в ограниченной очереди
+  scheduleRemesh(x, z);
+  {
+    std::lock_guard<std::mutex> lock(m_jobsMutex);
+    if (auto it = m_chunksInGeneration.find(getChunkKey(x, z));
+        it != m_chunksInGeneration.end() && it->second.requestId == requestId) {
+      m_chunksInGeneration.erase(it);
+    }
   }
+  wakeUp();
+}
+
+void ChunksManager::meshChunk(int x, int z, uint64_t requestId) {
+  ZoneScoped;
+  if (auto chunk = getChunkAt(x, z)) {
+    auto neighbors = getChunksAroundChunk(x, z);
+    if (chunk->generateVerticesAndIndices(neighbors[2], neighbors[3], neighbors[0], neighbors[1])) {
+      if (m_stageListener) {
+        m_stageListener(x, z, ChunkState::MeshReady);
+      }
+      m_uploadQueue.push(chunk);
+      // Сосед мог появиться во время мешинга, когда onChunkArrived ещё видел старую маску
+      if (const uint8_t missing = chunk->getMissingNeighbors(); missing != 0) {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        if (((missing & Chunk::LEFT_NEIGHBOR) && getChunkAtUnlocked(x - 1, z)) ||
+            ((missing & Chunk::RIGHT_NEIGHBOR) && getChunkAtUnlocked(x + 1, z)) ||
+            ((missing & Chunk::FRONT_NEIGHBOR) && getChunkAtUnlocked(x, z - 1)) ||
+            ((missing & Chunk::BACK_NEIGHBOR) && getChunkAtUnlocked(x, z + 1))) {
+          markChunkDirty(chunk);
+        }
+      }
+    } else if (chunk->getState() == ChunkState::Generated) {
+      // Чанк изменился во время мешинга
+      scheduleRemesh(x, z);
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_jobsMutex);
+    if (auto it = m_chunksInMeshing.find(getChunkKey(x, z));
+        it != m_chunksInMeshing.end() && it->second.requestId == requestId) {
+      m_chunksInMeshing.erase(it);
+    }
+  }
+  // Освободившийся слот - следующему чанку
+  wakeUp();
 }
 
 void ChunksManager::moveChunks() {
   ZoneScoped;
-  std::shared_lock<std::shared_mutex> lock(m_mutex);
   const int playerX = m_playerController.getChunkX();
   const int playerZ = m_playerController.getChunkZ();
   if (m_chunkLastMovedX == playerX && m_chunkLastMovedZ == playerZ) {
     return;
   };
-  m_shouldUpdateChunksToRender.store(true);
-  const int dX = playerX - m_chunkLastMovedX;
-  const int dZ = playerZ - m_chunkLastMovedZ;
+  // Воркеры читают m_chunkLastMovedX/Z под m_mutex, поэтому меняем их под уникальной блокировкой
+  std::unique_lock<std::shared_mutex> lock(m_mutex);
   m_chunkLastMovedX = playerX;
   m_chunkLastMovedZ = playerZ;
   std::vector<std::shared_ptr<Chunk>> newChunks(m_chunks.size());
@@ -120,7 +421,23 @@ void ChunksManager::moveChunks() {
   int maxX = playerX + m_loadRadius;
   int minZ = playerZ - m_loadRadius;
   int maxZ = playerZ + m_loadRadius;
-
+  const auto expiresAt = std::chrono::steady_clock::now() + m_retentionTime;
+
+  // Удержанные и предзагруженные чанки возвращаются в сетку без генерации и мешинга
+  for (auto it = m_chunkCache.begin(); it != m_chunkCache.end();) {
+    const auto &chunk = it->second.chunk;
+    if (isInLoadRadius(chunk->x(), chunk->z())) {
+      newChunks[getChunkIdx(chunk->x(), chunk->z())] = chunk;
+      chunk->setMemoryAccount(m_memoryCounters, Chunk::MemoryAccount::Grid);
+      if (chunk->getState() == ChunkState::Generated) {
+        std::lock_guard<std::mutex> jobsLock(m_jobsMutex);
+        m_dirtyChunks.insert(it->first);
+      }
+      it = m_chunkCache.erase(it);
+    } else {
+      ++it;
+    }
+  }
   for (auto &chunk : m_chunks) {
     if (!chunk) {
       continue;
@@ -128,83 +445,185 @@ void ChunksManager::moveChunks() {
     auto x = chunk->x();
     auto z = chunk->z();
     if (x < minX || x > maxX || z < minZ || z > maxZ) {
+      // Соседи по-прежнему резидентны, поэтому меши новых граничных чанков остаются верными.
+      // Лишнее удалит evictCachedChunks.
+      m_chunkCache[getChunkKey(x, z)] = {chunk, expiresAt};
+      chunk->setMemoryAccount(m_memoryCounters, Chunk::MemoryAccount::Cache);
       continue;
     }
-    if (x == minX || x == maxX || z == minZ || z == maxZ) {
-      chunk->setIsModified(true);
-    }
     auto idx = getChunkIdx(x, z);
     if (idx < m_chunks.size()) {
       newChunks[idx] = chunk;
     }
   }
-  lock.unlock();
-  std::unique_lock<std::shared_mutex> lock2(m_mutex);
   std::swap(m_chunks, newChunks);
+  markGridDirty();
+  lock.unlock();
+
+  m_isLoadQueueDirty = true;
+  m_isChunkCacheDirty = true;
+  releaseDeferredChunks();
+}
+
+glm::ivec2 ChunksManager::getPrefetchOffset() const {
+  const glm::vec3 velocity = m_playerController.getVelocity();
+  glm::vec2 offset = glm::vec2(velocity.x, velocity.z) * (m_prefetchSeconds / Chunk::CHUNK_SIZE);
+  // Дальше радиуса загрузки заглядывать бессмысленно: область уже не пересекается с сеткой
+  const float length = glm::length(offset);
+  const float maxLength = static_cast<float>(m_effectiveLoadRadius.load());
+  if (length > maxLength) {
+    offset *= maxLength / length;
+  }
+  return {static_cast<int>(std::lround(offset.x)), static_cast<int>(std::lround(offset.y))};
 }
 
-bool ChunksManager::isChunkVisible(const Frustum &frustum, int x, int z) {
+void ChunksManager::updatePrefetchRegion() {
   ZoneScoped;
-  const glm::vec4 *planes = frustum.getPlanes();
-  const int playerX = m_playerController.getChunkX();
-  const int playerZ = m_playerController.getChunkZ();
+  const glm::ivec2 offset = getPrefetchOffset();
+  int minX = 0;
+  int maxX = -1;
+  int minZ = 0;
+  int maxZ = -1;
+  if (offset.x != 0 || offset.y != 0) {
+    minX = m_chunkLastMovedX + offset.x - m_loadRadius;
+    maxX = m_chunkLastMovedX + offset.x + m_loadRadius;
+    minZ = m_chunkLastMovedZ + offset.y - m_loadRadius;
+    maxZ = m_chunkLastMovedZ + offset.y + m_loadRadius;
+  }
+  if (minX == m_prefetchMinX && maxX == m_prefetchMaxX && minZ == m_prefetchMinZ && maxZ == m_prefetchMaxZ) {
+    return;
+  }
 
-  // Определяем углы чанка
-  glm::vec3 min = glm::vec3((x - playerX) * Chunk::CHUNK_SIZE, 0, (z - playerZ) * Chunk::CHUNK_SIZE);
-  glm::vec3 max = min + glm::vec3(Chunk::CHUNK_SIZE, Chunk::CHUNK_HEIGHT, Chunk::CHUNK_SIZE);
+  {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_prefetchMinX = minX;
+    m_prefetchMaxX = maxX;
+    m_prefetchMinZ = minZ;
+    m_prefetchMaxZ = maxZ;
+  }
+  m_isChunkCacheDirty = true;
+  m_isLoadQueueDirty = true;
+}
 
-  for (int i = 0; i < 6; ++i) {
-    // Проверяем плоскость
-    if (planes[i].x * min.x + planes[i].y * min.y + planes[i].z * min.z + planes[i].w > 0)
-      continue;
-    if (planes[i].x * max.x + planes[i].y * min.y + planes[i].z * min.z + planes[i].w > 0)
-      continue;
-    if (planes[i].x * min.x + planes[i].y * max.y + planes[i].z * min.z + planes[i].w > 0)
-      continue;
-    if (planes[i].x * max.x + planes[i].y * max.y + planes[i].z * min.z + planes[i].w > 0)
-      continue;
-    if (planes[i].x * min.x + planes[i].y * min.y + planes[i].z * max.z + planes[i].w > 0)
-      continue;
-    if (planes[i].x * max.x + planes[i].y * min.y + planes[i].z * max.z + planes[i].w > 0)
-      continue;
-    if (planes[i].x * min.x + planes[i].y * max.y + planes[i].z * max.z + planes[i].w > 0)
+void ChunksManager::evictCachedChunks() {
+  ZoneScoped;
+  const auto now = std::chrono::steady_clock::now();
+  const bool isFlushRequested = std::exchange(m_isChunkCacheFlushRequested, false);
+  auto nextExpiry = std::chrono::steady_clock::time_point::max();
+  {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    std::vector<std::shared_ptr<Chunk>> evictedChunks;
+    for (auto it = m_chunkCache.begin(); it != m_chunkCache.end();) {
+      const auto &[chunk, expiresAt] = it->second;
+      if (!isFlushRequested && isInPrefetchRegion(chunk->x(), chunk->z())) {
+        ++it;
+        continue;
+      }
+      if (!isFlushRequested && isInRetentionRing(chunk->x(), chunk->z()) && now < expiresAt) {
+        nextExpiry = std::min(nextExpiry, expiresAt);
+        ++it;
+        continue;
+      }
+      evictedChunks.push_back(chunk);
+      it = m_chunkCache.erase(it);
+    }
+    // Соседи выгруженного чанка должны заново построить грани на границе с ним
+    for (const auto &chunk : evictedChunks) {
+      chunk->markEvicting();
+      chunk->setMemoryAccount(m_memoryCounters, Chunk::MemoryAccount::None);
+      markNeighborsDirty(chunk->x(), chunk->z());
+    }
+    m_cachedChunksCount.store(m_chunkCache.size());
+  }
+  m_nextCacheExpiry = nextExpiry;
+  m_isChunkCacheDirty = false;
+  cancelStaleJobs();
+}
+
+void ChunksManager::markChunkDirty(const std::shared_ptr<Chunk> &chunk) {
+  if (chunk->markDirty()) {
+    std::lock_guard<std::mutex> lock(m_jobsMutex);
+    m_dirtyChunks.insert(getChunkKey(chunk->x(), chunk->z()));
+  }
+}
+
+void ChunksManager::markNeighborsDirty(int x, int z) {
+  for (auto neighbor : {getChunkAtUnlocked(x - 1, z), getChunkAtUnlocked(x + 1, z), getChunkAtUnlocked(x, z - 1),
+                        getChunkAtUnlocked(x, z + 1)}) {
+    if (neighbor) {
+      markChunkDirty(neighbor);
+    }
+  }
+}
+
+void ChunksManager::onChunkArrived(int x, int z) {
+  struct Neighbor {
+    int x;
+    int z;
+    // Сторона соседа, с которой находится новый чанк
+    uint8_t side;
+  };
+  for (const auto &[neighborX, neighborZ, side] :
+       {Neighbor{x - 1, z, Chunk::RIGHT_NEIGHBOR}, Neighbor{x + 1, z, Chunk::LEFT_NEIGHBOR},
+        Neighbor{x, z - 1, Chunk::BACK_NEIGHBOR}, Neighbor{x, z + 1, Chunk::FRONT_NEIGHBOR}}) {
+    auto neighbor = getChunkAtUnlocked(neighborX, neighborZ);
+    if (!neighbor) {
       continue;
-    if (planes[i].x * max.x + planes[i].y * max.y + planes[i].z * max.z + planes[i].w > 0)
+    }
+    // Ещё не мешенные соседи увидят новый чанк сами, полный перемешинг нужен только построенным без него
+    if (neighbor->getMissingNeighbors() & side) {
+      markChunkDirty(neighbor);
       continue;
-
-    // Если чанк полностью за плоскостью, он невидим
-    return false;
+    }
+    const auto key = getChunkKey(neighborX, neighborZ);
+    std::lock_guard<std::mutex> lock(m_jobsMutex);
+    if (m_deferredChunks.erase(key) > 0) {
+      m_dirtyChunks.insert(key);
+    }
   }
-  return true; // Чанк видим
 }
 
-std::vector<std::shared_ptr<Chunk>> ChunksManager::getChunksToRender() {
-  ZoneScoped;
-  std::lock_guard<std::mutex> lock(m_renderMutex);
-  return m_chunksToRender;
+bool ChunksManager::isWaitingForNeighbors(int x, int z) const noexcept {
+  // Ждём только соседей в радиусе: они уже в очереди загрузки. Меш на границе радиуса строится сразу.
+  auto isMissing = [this](int neighborX, int neighborZ) {
+    return isInLoadRadius(neighborX, neighborZ) && !getChunkAtUnlocked(neighborX, neighborZ);
+  };
+  return isInLoadRadius(x, z) &&
+         (isMissing(x - 1, z) || isMissing(x + 1, z) || isMissing(x, z - 1) || isMissing(x, z + 1));
+}
+
+void ChunksManager::releaseDeferredChunks() {
+  std::lock_guard<std::mutex> lock(m_jobsMutex);
+  m_dirtyChunks.merge(m_deferredChunks);
+  m_deferredChunks.clear();
+}
+
+void ChunksManager::scheduleRemesh(int x, int z) {
+  {
+    std::lock_guard<std::mutex> lock(m_jobsMutex);
+    m_dirtyChunks.insert(getChunkKey(x, z));
+  }
+  wakeUp();
 }
 
 void ChunksManager::insertChunk(std::shared_ptr<Chunk> chunk) {
   ZoneScoped;
   auto x = chunk->x();
   auto z = chunk->z();
-  if (x < m_chunkLastMovedX - m_loadRadius || x > m_chunkLastMovedX + m_loadRadius ||
-      z < m_chunkLastMovedZ - m_loadRadius || z > m_chunkLastMovedZ + m_loadRadius) {
-    return;
-  }
-  auto idx = getChunkIdx(chunk->x(), chunk->z());
-  if (idx >= m_chunks.size()) {
-    return;
-  }
   std::unique_lock<std::shared_mutex> lock(m_mutex);
-  m_chunks[idx] = chunk;
-  lock.unlock();
-  auto neighbors = getChunksAroundChunk(x, z);
-  for (auto nextChunk : neighbors) {
-    if (nextChunk) {
-      nextChunk->setIsModified(true);
-    }
+  if (isInLoadRadius(x, z)) {
+    m_chunks[getChunkIdx(x, z)] = chunk;
+    chunk->setMemoryAccount(m_memoryCounters, Chunk::MemoryAccount::Grid);
+    markTileDirty(x, z);
+  } else if (isInPrefetchRegion(x, z)) {
+    m_chunkCache[getChunkKey(x, z)] = {chunk, std::chrono::steady_clock::now() + m_retentionTime};
+    chunk->setMemoryAccount(m_memoryCounters, Chunk::MemoryAccount::Cache);
+    m_cachedChunksCount.store(m_chunkCache.size());
+  } else {
+    chunk->markEvicting();
+    return;
   }
+  onChunkArrived(x, z);
 }
 
 void ChunksManager::forEachChunk(std::function<void(std::shared_ptr<Chunk>)> func) {
@@ -219,116 +638,152 @@ void ChunksManager::forEachChunk(std::function<void(std::shared_ptr<Chunk>)> fun
 
 void ChunksManager::updateModifiedChunks() {
   ZoneScoped;
-  std::vector<std::shared_ptr<Chunk>> chunksToUpdate;
-  std::shared_lock<std::shared_mutex> lock(m_mutex);
-
-  auto addChunkIfModified = [this, &chunksToUpdate](size_t index) {
-    ZoneScopedN("addChunkIfValid");
-    if (m_chunks[index] && m_chunks[index]->isModified()) {
-      chunksToUpdate.push_back(m_chunks[index]);
+  const glm::vec2 viewDirection = getViewDirection2D();
+  std::vector<ChunkRequest> chunksToUpdate;
+  std::vector<std::tuple<int, int, uint64_t>> jobsToSubmit;
+  {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    std::lock_guard<std::mutex> jobsLock(m_jobsMutex);
+    // Очередь загрузки на GPU ограничена: если поток рендера не успевает, мешинг ждёт
+    const int inFlight = static_cast<int>(m_chunksInMeshing.size());
+    const int uploadQueueSpace = static_cast<int>(UPLOAD_QUEUE_CAPACITY) - static_cast<int>(m_uploadQueue.size());
+    const size_t freeSlots =
+        static_cast<size_t>(std::max(0, std::min(m_meshingSlots - inFlight, uploadQueueSpace - inFlight)));
+    if (freeSlots == 0) {
+      return;
     }
-  };
-
-  addChunkIfModified(m_centerIdx);
-
-  size_t radius = 1;
-  while (radius <= m_loadRadius && chunksToUpdate.size() < m_maxAsyncChunksToUpdate) {
-    size_t offset = radius * m_chunksVectorSideSize;
-    size_t topLeft = m_centerIdx - radius - offset;
-    size_t topRight = m_centerIdx + radius - offset;
-    size_t bottomLeft = m_centerIdx - radius + offset;
-    size_t bottomRight = m_centerIdx + radius + offset;
 
-    for (size_t i = topLeft; i <= topRight; i++) {
-      if (chunksToUpdate.size() >= m_maxAsyncChunksToUpdate) {
-        break;
+    // Вместо обхода всей сетки смотрим только чанки, перешедшие в Generated.
+    // Чанки в Meshing, MeshReady и Uploading сами вернутся сюда, если их результат устареет.
+    for (auto it = m_dirtyChunks.begin(); it != m_dirtyChunks.end();) {
+      const int x = static_cast<int32_t>(*it >> 32);
+      const int z = static_cast<int32_t>(*it & 0xFFFFFFFFu);
+      // Предзагруженные чанки мешим, только если это разрешено настройкой
+      const auto chunk = isInLoadRadius(x, z) || m_isPrefetchMeshingEnabled ? getChunkAtUnlocked(x, z) : nullptr;
+      if (!chunk || chunk->getState() != ChunkState::Generated || m_chunksInMeshing.contains(*it)) {
+        it = m_dirtyChunks.erase(it);
+        continue;
       }
-      addChunkIfModified(i);
-    }
-    for (size_t i = bottomLeft; i <= bottomRight; i++) {
-      if (chunksToUpdate.size() >= m_maxAsyncChunksToUpdate) {
-        break;
+      // Меш без соседа пришлось бы строить заново, когда тот догенерируется
+      if (!chunk->hasMesh() && isWaitingForNeighbors(x, z)) {
+        m_deferredChunks.insert(*it);
+        it = m_dirtyChunks.erase(it);
+        continue;
       }
-      addChunkIfModified(i);
+      chunksToUpdate.push_back({x, z, getChunkPriority(x, z, viewDirection)});
+      ++it;
     }
-    for (size_t i = topLeft + m_chunksVectorSideSize; i < bottomLeft; i += m_chunksVectorSideSize) {
-      if (chunksToUpdate.size() >= m_maxAsyncChunksToUpdate) {
-        break;
-      }
-      addChunkIfModified(i);
-    }
-    for (size_t i = topRight + m_chunksVectorSideSize; i < bottomRight; i += m_chunksVectorSideSize) {
-      if (chunksToUpdate.size() >= m_maxAsyncChunksToUpdate) {
-        break;
-      }
-      addChunkIfModified(i);
+    const size_t count = std::min(freeSlots, chunksToUpdate.size());
+    std::partial_sort(chunksToUpdate.begin(), chunksToUpdate.begin() + count, chunksToUpdate.end(),
+                      [](const ChunkRequest &a, const ChunkRequest &b) { return a.priority < b.priority; });
+    chunksToUpdate.resize(count);
+
+    for (const auto &request : chunksToUpdate) {
+      const auto key = getChunkKey(request.x, request.z);
+      const auto requestId = m_nextRequestId++;
+      m_chunksInMeshing[key] = {nullptr, requestId};
+      m_dirtyChunks.erase(key);
+      jobsToSubmit.push_back({request.x, request.z, requestId});
     }
-    radius++;
   }
 
-  if (chunksToUpdate.size()) {
-    m_shouldUpdateChunksToRender.store(true);
+  if (jobsToSubmit.empty()) {
+    return;
+  }
+  std::lock_guard<std::mutex> jobsLock(m_jobsMutex);
+  for (const auto &[x, z, requestId] : jobsToSubmit) {
+    auto job = m_jobSystem.submit([this, x, z, requestId]() { meshChunk(x, z, requestId); });
+    if (auto it = m_chunksInMeshing.find(getChunkKey(x, z));
+        it != m_chunksInMeshing.end() && it->second.requestId == requestId) {
+      it->second.job = job;
+    }
   }
+}
 
-  std::vector<std::future<void>> futures;
+void ChunksManager::markTileDirty(int x, int z) {
+  std::lock_guard<std::mutex> lock(m_tilesMutex);
+  m_dirtyTiles.insert(getChunkKey(ChunksTile::toTilePos(x), ChunksTile::toTilePos(z)));
+}
 
-  for (const auto chunks : chunksToUpdate | std::ranges::views::chunk(MAX_CHUNKS_TO_UPDATE_PER_THREAD)) {
-    futures.emplace_back(std::async(std::launch::async, [this, chunks]() {
-      for (auto chunk : chunks) {
-        const auto x = chunk->x();
-        const auto z = chunk->z();
-        auto chunks = getChunksAroundChunk(x, z);
-        chunk->generateVerticesAndIndices(chunks[2], chunks[3], chunks[0], chunks[1]);
-      }
-    }));
-  }
+void ChunksManager::markGridDirty() {
+  std::lock_guard<std::mutex> lock(m_tilesMutex);
+  m_isGridDirty = true;
+}
 
-  for (auto &fut : futures) {
-    fut.get();
+std::shared_ptr<ChunksTile> ChunksManager::createTile(int minX, int maxX, int minZ, int maxZ) const {
+  auto tile = std::make_shared<ChunksTile>();
+  tile->minX = minX;
+  tile->maxX = maxX;
+  tile->minZ = minZ;
+  tile->maxZ = maxZ;
+  tile->chunks.reserve(static_cast<size_t>((maxX - minX + 1) * (maxZ - minZ + 1)));
+  VerticalBounds bounds = {Chunk::CHUNK_HEIGHT, 0};
+  for (int z = minZ; z <= maxZ; z++) {
+    for (int x = minX; x <= maxX; x++) {
+      // Пустое небо над рельефом не делает чанк видимым. Для дыр берём всю высоту: рельеф ещё неизвестен.
+      const auto &chunk = m_chunks[getChunkIdx(x, z)];
+      const VerticalBounds chunkBounds = chunk ? chunk->getMeshBounds() : VerticalBounds{0, Chunk::CHUNK_HEIGHT};
+      if (!chunkBounds.isEmpty()) {
+        bounds.minY = std::min(bounds.minY, chunkBounds.minY);
+        bounds.maxY = std::max(bounds.maxY, chunkBounds.maxY);
+      }
+      tile->chunks.push_back(chunk);
+    }
   }
+  tile->setBounds(bounds.isEmpty() ? VerticalBounds{0, 0} : bounds);
+  return tile;
 }
 
-void ChunksManager::updateChunksToRender() {
+void ChunksManager::publishSnapshot() {
   ZoneScoped;
-  bool expected = true;
-  if (!m_shouldUpdateChunksToRender.compare_exchange_strong(expected, false)) {
+  std::unordered_set<uint64_t> dirtyTiles;
+  bool isGridDirty = false;
+  {
+    std::lock_guard<std::mutex> lock(m_tilesMutex);
+    std::swap(dirtyTiles, m_dirtyTiles);
+    isGridDirty = std::exchange(m_isGridDirty, false);
+  }
+  if (!isGridDirty && dirtyTiles.empty()) {
     return;
   }
-  std::shared_lock<std::shared_mutex> lock(m_mutex);
-  std::vector<std::shared_ptr<Chunk>> chunksToRender;
-  chunksToRender.reserve(m_chunks.size() / 2);
 
-  auto addChunkIfValid = [&](size_t index) {
-    ZoneScopedN("addChunkIfValid");
-    if (m_chunks[index] && isChunkVisible(m_frustum, m_chunks[index]->x(), m_chunks[index]->z())) {
-      chunksToRender.push_back(m_chunks[index]);
-    }
-  };
-  addChunkIfValid(m_centerIdx);
-
-  size_t radius = 1;
-  while (radius <= m_loadRadius) {
-    size_t offset = radius * m_chunksVectorSideSize;
-    size_t topLeft = m_centerIdx - radius - offset;
-    size_t topRight = m_centerIdx + radius - offset;
-    size_t bottomLeft = m_centerIdx - radius + offset;
-    size_t bottomRight = m_centerIdx + radius + offset;
-
-    for (size_t i = topLeft; i <= topRight; i++) {
-      addChunkIfValid(i);
-    }
-    for (size_t i = bottomLeft; i <= bottomRight; i++) {
-      addChunkIfValid(i);
-    }
-    for (size_t i = topLeft + m_chunksVectorSideSize; i < bottomLeft; i += m_chunksVectorSideSize) {
-      addChunkIfValid(i);
-    }
-    for (size_t i = topRight + m_chunksVectorSideSize; i < bottomRight; i += m_chunksVectorSideSize) {
-      addChunkIfValid(i);
+  std::shared_lock<std::shared_mutex> lock(m_mutex);
+  auto snapshot = std::make_shared<ChunksSnapshot>();
+  snapshot->centerX = m_chunkLastMovedX;
+  snapshot->centerZ = m_chunkLastMovedZ;
+  snapshot->loadRadius = m_loadRadius;
+  const int minX = m_chunkLastMovedX - m_loadRadius;
+  const int maxX = m_chunkLastMovedX + m_loadRadius;
+  const int minZ = m_chunkLastMovedZ - m_loadRadius;
+  const int maxZ = m_chunkLastMovedZ + m_loadRadius;
+  snapshot->minTileX = ChunksTile::toTilePos(minX);
+  snapshot->minTileZ = ChunksTile::toTilePos(minZ);
+  snapshot->tilesCountX = ChunksTile::toTilePos(maxX) - snapshot->minTileX + 1;
+  snapshot->tilesCountZ = ChunksTile::toTilePos(maxZ) - snapshot->minTileZ + 1;
+  snapshot->tiles.reserve(static_cast<size_t>(snapshot->tilesCountX * snapshot->tilesCountZ));
+
+  std::unordered_map<uint64_t, std::shared_ptr<ChunksTile>> tiles;
+  tiles.reserve(snapshot->tiles.capacity());
+  for (int tileZ = snapshot->minTileZ; tileZ < snapshot->minTileZ + snapshot->tilesCountZ; tileZ++) {
+    for (int tileX = snapshot->minTileX; tileX < snapshot->minTileX + snapshot->tilesCountX; tileX++) {
+      const int tileMinX = std::max(tileX * ChunksTile::SIZE, minX);
+      const int tileMaxX = std::min((tileX + 1) * ChunksTile::SIZE - 1, maxX);
+      const int tileMinZ = std::max(tileZ * ChunksTile::SIZE, minZ);
+      const int tileMaxZ = std::min((tileZ + 1) * ChunksTile::SIZE - 1, maxZ);
+      const uint64_t key = getChunkKey(tileX, tileZ);
+      // Внутренние тайлы при сдвиге сетки не меняются: те же чанки, та же обрезка
+      std::shared_ptr<ChunksTile> tile;
+      if (auto it = m_tiles.find(key); it != m_tiles.end() && !dirtyTiles.contains(key) &&
+                                       it->second->minX == tileMinX && it->second->maxX == tileMaxX &&
+                                       it->second->minZ == tileMinZ && it->second->maxZ == tileMaxZ) {
+        tile = it->second;
+      } else {
+        tile = createTile(tileMinX, tileMaxX, tileMinZ, tileMaxZ);
+      }
+      snapshot->tiles.push_back(tile);
+      tiles.emplace(key, std::move(tile));
     }
-    radius++;
   }
-
-  std::lock_guard<std::mutex> lock2(m_renderMutex);
-  std::swap(m_chunksToRender, chunksToRender);
-}
\ No newline at end of file
+  std::swap(m_tiles, tiles);
+  m_snapshot.store(std::move(snapshot), std::memory_order_release);
+}
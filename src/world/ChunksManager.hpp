@@ -1,34 +1,97 @@
 #pragma once
 
-#include "../core/Frustum.hpp"
+#include "../assets/ConfigLoader.hpp"
+#include "../core/JobSystem.hpp"
 #include "BlocksManager.hpp"
 #include "Chunk.hpp"
+#include "ChunkUploadQueue.hpp"
+#include "ChunksCuller.hpp"
 #include "PlayerController.hpp"
-#include "TextureAtlas.hpp"
 #include "WorldGenerator.hpp"
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <shared_mutex>
 #include <thread>
 #include <tracy/Tracy.hpp>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 class ChunksManager {
 public:
-  ChunksManager(BlocksManager &blocksManager, TextureAtlas &textureAtlas, PlayerController &playerController);
+  // Вызывается из воркеров, когда чанк стал Generated или MeshReady; нужен для замеров задержек конвейера
+  using StageListener = std::function<void(int x, int z, ChunkState state)>;
+
+  ChunksManager(BlocksManager &blocksManager, PlayerController &playerController, const Config &config,
+                StageListener stageListener = nullptr);
   ~ChunksManager();
 
-  std::vector<std::shared_ptr<Chunk>> getChunksToRender();
+  // Последний опубликованный срез сетки для отсечения в потоке рендера, без блокировок менеджера
+  inline std::shared_ptr<const ChunksSnapshot> getSnapshot() const noexcept {
+    return m_snapshot.load(std::memory_order_acquire);
+  }
   void insertChunk(std::shared_ptr<Chunk> chunk);
   void forEachChunk(std::function<void(std::shared_ptr<Chunk>)> func);
-  inline void updateFrustum(Frustum &frustum) noexcept {
-    if (frustum != m_frustum) {
-      m_frustum = frustum;
-      m_shouldUpdateChunksToRender.store(true);
-    }
+  // Вызывается каждый кадр, будит менеджер, только когда камера повернулась достаточно для смены приоритетов
+  void updateView(const glm::vec3 &viewDirection);
+  // Вызывается каждый кадр после обновления игрока, будит менеджер только при смене чанка или области предзагрузки
+  void notifyPlayerMoved();
+  // Загружает готовые меши на GPU из потока рендера, ближайшие к игроку первыми
+  ChunkUploadQueue::Stats uploadMeshes(const ChunkUploadQueue::Budget &budget,
+                                       const ChunkUploadQueue::Uploader &upload);
+
+  void setLoadRadius(int radius);
+  inline int getLoadRadius() const noexcept { return m_targetLoadRadius.load(); }
+  // Может быть меньше заданного, если не хватает бюджета памяти
+  inline int getEffectiveLoadRadius() const noexcept { return m_effectiveLoadRadius.load(); }
+  // 0 - без ограничения
+  void setMemoryBudget(size_t bytes);
+  inline size_t getMemoryBudget() const noexcept { return m_memoryBudget.load(); }
+  inline size_t getMemoryUsage() const noexcept {
+    return m_memoryCounters->grid.getBytes() + m_memoryCounters->cache.getBytes();
+  }
+  // Предзагруженные и удерживаемые после выхода из радиуса
+  inline size_t getCachedChunksCount() const noexcept { return m_cachedChunksCount.load(); }
+
+  struct PipelineStats {
+    size_t generating;
+    size_t meshQueueDepth;
+    // Ждут соседей в радиусе загрузки, чтобы мешиться один раз
+    size_t meshDeferred;
+    size_t meshing;
+    size_t uploadQueueDepth;
+    int generationSlots;
+    int meshingSlots;
+  };
+  inline WorldGenerator::Stats getGenerationStats() const noexcept { return m_worldGenerator.getStats(); }
+  inline PipelineStats getPipelineStats() noexcept {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_pipelineStats;
   }
 
+public:
+  static constexpr int MIN_LOAD_RADIUS = 2;
+  static constexpr int MAX_LOAD_RADIUS = 64;
+
 private:
+  struct ChunkRequest {
+    int x;
+    int z;
+    float priority;
+  };
+  struct ChunkJob {
+    JobHandle job;
+    uint64_t requestId;
+  };
+  struct CachedChunk {
+    std::shared_ptr<Chunk> chunk;
+    std::chrono::steady_clock::time_point expiresAt;
+  };
+
   inline int toChunkPos(int x) const noexcept {
     ZoneScoped;
     if (x >= 0) {
@@ -38,23 +101,38 @@ private:
   };
   inline size_t getChunkIdx(int x, int z) const noexcept {
     ZoneScoped;
-    return (x - m_chunkLastMovedX + m_loadRadius) + (z - m_chunkLastMovedZ + m_loadRadius) * m_chunksVectorSideSize;
+    return (x - m_chunkLastMovedX + MAX_LOAD_RADIUS) +
+           (z - m_chunkLastMovedZ + MAX_LOAD_RADIUS) * CHUNKS_GRID_SIDE_SIZE;
   }
-  inline std::shared_ptr<Chunk> getChunkAt(int x, int z) noexcept {
-    ZoneScoped;
-    if (x > m_chunkLastMovedX + m_loadRadius || x < m_chunkLastMovedX - m_loadRadius ||
-        z > m_chunkLastMovedZ + m_loadRadius || z < m_chunkLastMovedZ - m_loadRadius) {
-      return nullptr;
+  inline static uint64_t getChunkKey(int x, int z) noexcept {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(z);
+  }
+  inline bool isInLoadRadius(int x, int z) const noexcept {
+    return x >= m_chunkLastMovedX - m_loadRadius && x <= m_chunkLastMovedX + m_loadRadius &&
+           z >= m_chunkLastMovedZ - m_loadRadius && z <= m_chunkLastMovedZ + m_loadRadius;
+  }
+  inline bool isInPrefetchRegion(int x, int z) const noexcept {
+    return x >= m_prefetchMinX && x <= m_prefetchMaxX && z >= m_prefetchMinZ && z <= m_prefetchMaxZ &&
+           !isInLoadRadius(x, z);
+  }
+  inline bool isInRetentionRing(int x, int z) const noexcept {
+    const int distance = std::max(std::abs(x - m_chunkLastMovedX), std::abs(z - m_chunkLastMovedZ));
+    return distance <= m_loadRadius + m_retentionDistance;
+  }
+  // Вызывающий должен держать m_mutex
+  inline std::shared_ptr<Chunk> getChunkAtUnlocked(int x, int z) const noexcept {
+    if (isInLoadRadius(x, z)) {
+      return m_chunks[getChunkIdx(x, z)];
+    }
+    if (auto it = m_chunkCache.find(getChunkKey(x, z)); it != m_chunkCache.end()) {
+      return it->second.chunk;
     }
-    return getChunkAt(getChunkIdx(x, z));
+    return nullptr;
   }
-  inline std::shared_ptr<Chunk> getChunkAt(size_t idx) noexcept {
+  inline std::shared_ptr<Chunk> getChunkAt(int x, int z) noexcept {
     ZoneScoped;
-    if (idx >= m_chunks.size()) {
-      return nullptr;
-    }
     std::shared_lock<std::shared_mutex> lock(m_mutex);
-    return m_chunks[idx];
+    return getChunkAtUnlocked(x, z);
   }
   inline std::array<std::shared_ptr<Chunk>, 4> getChunksAroundChunk(int x, int z) noexcept {
     ZoneScoped;
@@ -66,36 +144,150 @@ private:
     return {leftChunk, rightChunk, frontChunk, backChunk};
   }
 
+  // Меньше - важнее: расстояние до игрока в чанках, увеличенное для чанков в стороне от направления взгляда
+  inline float getChunkPriority(int x, int z, const glm::vec2 &viewDirection) const noexcept {
+    const glm::vec2 offset(static_cast<float>(x - m_chunkLastMovedX), static_cast<float>(z - m_chunkLastMovedZ));
+    const float distance = glm::length(offset);
+    if (distance < 1.5f) {
+      return distance;
+    }
+    const float cosAngle = glm::dot(offset / distance, viewDirection);
+    return distance * (1.0f + VIEW_ANGLE_PRIORITY_WEIGHT * (1.0f - cosAngle) * 0.5f);
+  }
+  glm::vec2 getViewDirection2D();
+
   void asyncProcessChunks();
+  void wakeUp();
   void loadChunks();
+  void rebuildLoadQueue(const glm::vec2 &viewDirection);
+  void cancelStaleJobs();
+  void generateChunk(int x, int z, uint64_t requestId);
+  void meshChunk(int x, int z, uint64_t requestId);
   void moveChunks();
+  // Смещение области предзагрузки в чанках относительно игрока
+  glm::ivec2 getPrefetchOffset() const;
+  void updatePrefetchRegion();
+  void evictCachedChunks();
+  // Вызывающий должен держать m_mutex
+  void markChunkDirty(const std::shared_ptr<Chunk> &chunk);
+  // Вызывающий должен держать m_mutex
+  void markNeighborsDirty(int x, int z);
+  // Перестраивает соседей, чей меш построен без этого чанка, и возвращает в очередь ждавших его.
+  // Вызывающий должен держать m_mutex
+  void onChunkArrived(int x, int z);
+  // Вызывающий должен держать m_mutex
+  bool isWaitingForNeighbors(int x, int z) const noexcept;
+  void releaseDeferredChunks();
+  void scheduleRemesh(int x, int z);
+  void updateLoadRadius();
+  void applyLoadRadius(int radius);
   void updateModifiedChunks();
-  bool isChunkVisible(const Frustum &frustum, int x, int z);
-  void updateChunksToRender();
+  // Перераспределяет слоты задач между генерацией и мешингом в сторону узкого места
+  void rebalanceStages();
+  // Тайл чанка (x, z) пересоберётся при следующей публикации среза
+  void markTileDirty(int x, int z);
+  // Сетка сдвинулась или сменился радиус: меняется набор тайлов и обрезка граничных
+  void markGridDirty();
+  // Собирает заново грязные и граничные тайлы, остальные берёт из прошлого среза
+  void publishSnapshot();
+  // Вызывающий должен держать m_mutex
+  std::shared_ptr<ChunksTile> createTile(int minX, int maxX, int minZ, int maxZ) const;
 
 private:
-  bool m_isRunning = true;
-  std::atomic_bool m_shouldUpdateChunksToRender = false;
+  std::atomic_bool m_isRunning = true;
   int m_chunkLastMovedX = 0;
   int m_chunkLastMovedZ = 0;
   int m_maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 2);
-  static constexpr int MAX_CHUNKS_TO_UPDATE_PER_THREAD = 4;
-  static constexpr int MAX_CHUNKS_TO_LOAD_PER_THREAD = MAX_CHUNKS_TO_UPDATE_PER_THREAD * 20;
-  int m_maxAsyncChunksLoading = m_maxThreads * MAX_CHUNKS_TO_LOAD_PER_THREAD;
-  int m_maxAsyncChunksToUpdate = m_maxThreads * MAX_CHUNKS_TO_UPDATE_PER_THREAD;
-  int m_loadRadius = 32;
-  int m_chunksVectorSideSize = m_loadRadius * 2 + 1;
-  size_t m_centerIdx = m_loadRadius + m_loadRadius * m_chunksVectorSideSize;
+  // Конвейер генерация -> мешинг -> загрузка на GPU. Между стадиями ограниченные очереди:
+  // стадия не берёт новую работу, пока очередь следующей стадии заполнена.
+  // Держим очередь JobSystem короткой, чтобы новые приоритеты применялись быстро
+  static constexpr int MAX_JOBS_PER_THREAD = 8;
+  static constexpr size_t MESH_QUEUE_CAPACITY = 256;
+  static constexpr size_t UPLOAD_QUEUE_CAPACITY = 128;
+  // Чанк позади игрока ждёт как чанк впереди на расстоянии в (1 + VIEW_ANGLE_PRIORITY_WEIGHT) раз больше
+  static constexpr float VIEW_ANGLE_PRIORITY_WEIGHT = 2.0f;
+  // Косинус угла поворота камеры, после которого очередь загрузки пересортировывается (~15 градусов)
+  static constexpr float REPRIORITIZE_COS_ANGLE = 0.966f;
+  // Число задач каждой стадии в JobSystem; сумма постоянна, соотношение меняет rebalanceStages
+  int m_generationSlots = m_maxThreads * MAX_JOBS_PER_THREAD / 2;
+  int m_meshingSlots = m_maxThreads * MAX_JOBS_PER_THREAD - m_generationSlots;
+  std::mutex m_statsMutex;
+  PipelineStats m_pipelineStats = {};
+  // Сетка рассчитана на максимальный радиус, поэтому смена радиуса не перераспределяет память
+  static constexpr int CHUNKS_GRID_SIDE_SIZE = MAX_LOAD_RADIUS * 2 + 1;
+  static constexpr size_t CHUNKS_GRID_CENTER_IDX = MAX_LOAD_RADIUS + MAX_LOAD_RADIUS * CHUNKS_GRID_SIDE_SIZE;
+  // Радиус растёт, только если прогноз памяти для следующего кольца не превышает эту долю бюджета
+  static constexpr float MEMORY_BUDGET_GROW_THRESHOLD = 0.9f;
+  // Текущий радиус, меняется только потоком менеджера под m_mutex
+  int m_loadRadius = 0;
+  std::atomic_int m_targetLoadRadius;
+  std::atomic_int m_effectiveLoadRadius = 0;
+  std::atomic_size_t m_memoryBudget;
+  // Чанки сами обновляют счётчики при мешинге и загрузке, менеджер переносит их между сеткой и кэшем
+  const std::shared_ptr<Chunk::MemoryCounters> m_memoryCounters = std::make_shared<Chunk::MemoryCounters>();
   BlocksManager &m_blocksManager;
-  TextureAtlas &m_textureAtlas;
   PlayerController &m_playerController;
+  const StageListener m_stageListener;
   WorldGenerator m_worldGenerator;
   std::shared_mutex m_mutex;
-  std::mutex m_renderMutex;
-  Frustum m_frustum;
+  std::mutex m_viewMutex;
+  glm::vec3 m_viewDirection{0.0f, 0.0f, -1.0f};
 
   std::thread m_thread;
+  // Менеджер спит, пока не придёт событие: смена чанка игрока, изменение вида, завершение задачи
+  std::mutex m_eventsMutex;
+  std::condition_variable m_eventsCondition;
+  bool m_hasEvents = true;
+  int m_notifiedPlayerX = 0;
+  int m_notifiedPlayerZ = 0;
+  glm::ivec2 m_notifiedPrefetchOffset{0, 0};
+  glm::vec3 m_notifiedViewDirection{0.0f, 0.0f, -1.0f};
 
   std::vector<std::shared_ptr<Chunk>> m_chunks;
-  std::vector<std::shared_ptr<Chunk>> m_chunksToRender;
+  ChunkUploadQueue m_uploadQueue;
+  // Срез публикуется потоком менеджера; тайлы по ключу getChunkKey(tileX, tileZ) - его же копия для сборки следующего
+  std::atomic<std::shared_ptr<const ChunksSnapshot>> m_snapshot;
+  std::unordered_map<uint64_t, std::shared_ptr<ChunksTile>> m_tiles;
+  // Что сменилось с прошлой публикации; пишут поток менеджера и поток рендера при загрузке мешей
+  std::mutex m_tilesMutex;
+  std::unordered_set<uint64_t> m_dirtyTiles;
+  bool m_isGridDirty = true;
+
+  // Предзагрузка: квадрат радиуса m_loadRadius вокруг позиции игрока через m_prefetchSeconds.
+  // Удержание: покинувшие сетку чанки живут m_retentionTime в кольце шириной m_retentionDistance.
+  // Такие чанки лежат в m_chunkCache и переезжают в сетку без повторной генерации.
+  // Границы и кэш меняются потоком менеджера под m_mutex.
+  const float m_prefetchSeconds;
+  const bool m_isPrefetchMeshingEnabled;
+  const int m_retentionDistance;
+  const std::chrono::steady_clock::duration m_retentionTime;
+  int m_prefetchMinX = 0;
+  int m_prefetchMaxX = -1;
+  int m_prefetchMinZ = 0;
+  int m_prefetchMaxZ = -1;
+  bool m_isChunkCacheDirty = false;
+  // Выгрузить весь кэш на следующем проходе, когда превышен бюджет памяти
+  bool m_isChunkCacheFlushRequested = false;
+  std::chrono::steady_clock::time_point m_nextCacheExpiry = std::chrono::steady_clock::time_point::max();
+  std::unordered_map<uint64_t, CachedChunk> m_chunkCache;
+  std::atomic_size_t m_cachedChunksCount = 0;
+
+  // Отсортированы по убыванию priority, следующий чанк берётся с конца.
+  // Предзагрузка идёт только когда очередь сетки пуста.
+  std::vector<ChunkRequest> m_loadQueue;
+  std::vector<ChunkRequest> m_prefetchQueue;
+  bool m_isLoadQueueDirty = true;
+  glm::vec2 m_prioritizedViewDirection{0.0f, -1.0f};
+
+  std::mutex m_jobsMutex;
+  uint64_t m_nextRequestId = 0;
+  std::unordered_map<uint64_t, ChunkJob> m_chunksInGeneration;
+  std::unordered_map<uint64_t, ChunkJob> m_chunksInMeshing;
+  // Чанки, которым нужен мешинг; пополняется при переходах в Generated
+  std::unordered_set<uint64_t> m_dirtyChunks;
+  // Чанки из m_dirtyChunks, у которых ещё не сгенерирован сосед в радиусе загрузки. Не считаются
+  // в ограничении очереди мешинга, иначе генерация этих соседей могла бы встать.
+  std::unordered_set<uint64_t> m_deferredChunks;
+  // Объявлен последним, чтобы воркеры остановились раньше, чем разрушатся остальные поля
+  JobSystem m_jobSystem{m_maxThreads};
 };
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "PlayerController.hpp"
 #include "Chunk.hpp"
+#include <cmath>
 
 PlayerController::PlayerController(glm::vec3 playerPos) {
   m_playerPos =
@@ -11,6 +12,7 @@ PlayerController::PlayerController(glm::vec3 playerPos) {
 
 void PlayerController::move(glm::vec3 direction) {
   m_playerPos += direction;
+  m_frameDisplacement += direction;
   int dX = m_playerPos.x / Chunk::CHUNK_SIZE;
   int dZ = m_playerPos.z / Chunk::CHUNK_SIZE;
   // TODO проверить это
@@ -25,4 +27,14 @@ void PlayerController::move(glm::vec3 direction) {
 
   m_playerPos.x -= dX * Chunk::CHUNK_SIZE;
   m_playerPos.z -= dZ * Chunk::CHUNK_SIZE;
+}
+
+void PlayerController::update(float dt) {
+  if (dt <= 0.0f) {
+    return;
+  }
+  const float alpha = 1.0f - std::exp(-dt / VELOCITY_SMOOTHING_TIME);
+  std::lock_guard<std::mutex> lock(m_velocityMutex);
+  m_velocity += (m_frameDisplacement / dt - m_velocity) * alpha;
+  m_frameDisplacement = glm::vec3(0.0f);
 }
\ No newline at end of file
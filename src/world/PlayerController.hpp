@@ -3,6 +3,7 @@
 #include "Chunk.hpp"
 #include "glm/fwd.hpp"
 #include <glm/glm.hpp>
+#include <mutex>
 
 class PlayerController {
 public:
@@ -19,10 +20,24 @@ public:
   }
   inline float getWorldY() const noexcept { return m_playerPos.y; }
 
+  // Скорость в блоках в секунду, сглаженная по последним кадрам
+  inline glm::vec3 getVelocity() const noexcept {
+    std::lock_guard<std::mutex> lock(m_velocityMutex);
+    return m_velocity;
+  }
+
   void move(glm::vec3 direction);
+  // Вызывается раз в кадр после всех move
+  void update(float dt);
 
 private:
+  // Постоянная времени сглаживания скорости в секундах
+  static constexpr float VELOCITY_SMOOTHING_TIME = 0.25f;
+
   int m_playerX;
   int m_playerZ;
   glm::vec3 m_playerPos;
+  glm::vec3 m_frameDisplacement{0.0f};
+  glm::vec3 m_velocity{0.0f};
+  mutable std::mutex m_velocityMutex;
 };
\ No newline at end of file
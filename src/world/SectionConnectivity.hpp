@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+// Какие пары граней секции 16x16x16 соединены через воксели, сквозь которые видно (воздух, стекло).
+// 15 пар граней упакованы в биты uint16_t. Грань и противоположная ей отличаются младшим битом.
+class SectionConnectivity {
+public:
+  enum Face : uint8_t { NegX, PosX, NegY, PosY, NegZ, PosZ };
+
+  static constexpr int FACES_COUNT = 6;
+  static constexpr uint16_t ALL_CONNECTED = 0x7FFF;
+  static constexpr std::array<std::array<int, 3>, FACES_COUNT> FACE_DIRECTIONS = {{
+      {-1, 0, 0},
+      {1, 0, 0},
+      {0, -1, 0},
+      {0, 1, 0},
+      {0, 0, -1},
+      {0, 0, 1},
+  }};
+
+  inline static int getOpposite(int face) noexcept { return face ^ 1; }
+
+  inline static uint16_t getPairBit(int a, int b) noexcept {
+    if (a > b) {
+      std::swap(a, b);
+    }
+    // Номер пары (a, b), a < b, в порядке (0,1), (0,2), ..., (4,5)
+    const int idx = a * (FACES_COUNT - 1) - a * (a - 1) / 2 + (b - a - 1);
+    return static_cast<uint16_t>(1u << idx);
+  }
+
+  inline static bool isConnected(uint16_t connectivity, int a, int b) noexcept {
+    return a == b || (connectivity & getPairBit(a, b)) != 0;
+  }
+
+  // Соединяет попарно все грани из facesMask (бит на грань)
+  inline static uint16_t connectFaces(uint8_t facesMask) noexcept {
+    uint16_t connectivity = 0;
+    for (int a = 0; a < FACES_COUNT; a++) {
+      for (int b = a + 1; b < FACES_COUNT; b++) {
+        if ((facesMask & (1 << a)) && (facesMask & (1 << b))) {
+          connectivity |= getPairBit(a, b);
+        }
+      }
+    }
+    return connectivity;
+  }
+};
@@ -2,12 +2,16 @@
 #include <filesystem>
 
 TextureAtlas::TextureAtlas(RenderDeviceVk *renderDevice, std::string_view texturesPath)
-    : m_texture{renderDevice, getTexturesPaths(texturesPath)} {
+    : m_texturesIndices{loadTexturesIndices(texturesPath)}, m_texture{renderDevice, getTexturesPaths(texturesPath)} {}
+
+TextureAtlas::TexturesIndices TextureAtlas::loadTexturesIndices(std::string_view texturesPath) {
   auto textures = getTexturesNames(texturesPath);
 
+  TexturesIndices texturesIndices;
   for (size_t i = 0; i < textures.size(); i++) {
-    m_texturesIndices[textures[i]] = static_cast<float>(i);
+    texturesIndices[textures[i]] = static_cast<float>(i);
   }
+  return texturesIndices;
 }
 
 std::vector<std::string> TextureAtlas::getTexturesPaths(std::string_view texturesPath) {
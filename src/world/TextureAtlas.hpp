@@ -9,21 +9,27 @@
 
 class TextureAtlas {
 public:
+  using TexturesIndices = std::unordered_map<std::string, float>;
+
   TextureAtlas(RenderDeviceVk *renderDevice, std::string_view texturesPath);
 
+  // Индексы слоёв без загрузки текстур на GPU, для работы без Vulkan
+  static TexturesIndices loadTexturesIndices(std::string_view texturesPath);
+
   inline float getTextureIdx(const std::string &textureName) const noexcept {
     ZoneScoped;
     return m_texturesIndices.find(textureName)->second;
   }
 
+  inline const TexturesIndices &getTexturesIndices() const noexcept { return m_texturesIndices; }
   inline TextureVk &getTexture() noexcept { return m_texture; }
 
 private:
   static std::vector<std::string> getTexturesPaths(std::string_view texturesPath);
 
-  std::vector<std::string> getTexturesNames(std::string_view texturesPath);
+  static std::vector<std::string> getTexturesNames(std::string_view texturesPath);
 
 private:
-  std::unordered_map<std::string, float> m_texturesIndices;
+  TexturesIndices m_texturesIndices;
   TextureVk m_texture;
 };
\ No newline at end of file
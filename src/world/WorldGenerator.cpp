@@ -1,7 +1,60 @@
 #include "WorldGenerator.hpp"
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
 #include <memory>
 
+namespace {
+uint64_t mixHash(uint64_t x) noexcept {
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+uint64_t hashColumn(int x, int z) noexcept {
+  return mixHash((static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(z));
+}
+
+class SplitMix64 {
+public:
+  explicit SplitMix64(uint64_t seed) : m_state{seed} {}
+
+  inline uint64_t next() noexcept {
+    m_state += 0x9E3779B97F4A7C15ull;
+    return mixHash(m_state);
+  }
+  inline int nextInt(int min, int max) noexcept {
+    return min + static_cast<int>(next() % static_cast<uint64_t>(max - min + 1));
+  }
+
+private:
+  uint64_t m_state;
+};
+
+struct OreConfig {
+  BlockId block;
+  int veinsPerChunk;
+  int minY;
+  int maxY;
+  int minRadius;
+  int maxRadius;
+};
+
+constexpr std::array<OreConfig, 6> ORES = {{
+    {BlockId::CoalOre, 10, 5, 110, 1, 2},
+    {BlockId::IronOre, 7, 5, 64, 1, 2},
+    {BlockId::Gravel, 3, 5, 80, 2, 3},
+    {BlockId::GoldOre, 2, 5, 32, 1, 1},
+    {BlockId::RedstoneOre, 4, 5, 16, 1, 2},
+    {BlockId::DiamondOre, 1, 5, 16, 1, 1},
+}};
+
+// Вены не шире чанка, поэтому достаточно кандидатов из соседних 3x3 чанков
+static_assert(std::ranges::all_of(ORES, [](const OreConfig &ore) { return ore.maxRadius < Chunk::CHUNK_SIZE; }));
+} // namespace
+
 WorldGenerator::WorldGenerator(BlocksManager &blockManager) : m_blockManager{blockManager} {
   ZoneScoped;
   heightGenNoise = FastNoise::New<FastNoise::OpenSimplex2>();
@@ -9,62 +62,175 @@ WorldGenerator::WorldGenerator(BlocksManager &blockManager) : m_blockManager{blo
   heightGenFBm->SetSource(heightGenNoise);
   heightGenFBm->SetOctaveCount(2);
   tempNoise = FastNoise::New<FastNoise::OpenSimplex2>();
+  humidityNoise = FastNoise::New<FastNoise::OpenSimplex2>();
   node = FastNoise::NewFromEncodedNodeTree("EQACAAAAAAAgQBAAAAAAQBkAEwDD9Sg/"
                                            "DQAEAAAAAAAgQAkAAGZmJj8AAAAAPwEEAAAAAAAAAEBAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
                                            "AAAAAM3MTD4AMzMzPwAAAAA/");
 }
 
+void WorldGenerator::generateBiomeMap(Chunk &chunk, int cx, int cz) {
+  ZoneScoped;
+  constexpr int cellsPerChunk = Chunk::CHUNK_SIZE / BiomeMap::GRID_STEP;
+  std::array<float, BiomeMap::GRID_SQ_SIZE> temps;
+  std::array<float, BiomeMap::GRID_SQ_SIZE> humidities;
+  tempNoise->GenUniformGrid2D(temps.data(), cx * cellsPerChunk, cz * cellsPerChunk, BiomeMap::GRID_SIZE,
+                              BiomeMap::GRID_SIZE, 0.002f * BiomeMap::GRID_STEP, SEED);
+  humidityNoise->GenUniformGrid2D(humidities.data(), cx * cellsPerChunk, cz * cellsPerChunk, BiomeMap::GRID_SIZE,
+                                  BiomeMap::GRID_SIZE, 0.0015f * BiomeMap::GRID_STEP, SEED + 1);
+  chunk.m_biomeMap.build(temps, humidities);
+}
+
 std::shared_ptr<Chunk> WorldGenerator::generateChunk(int cx, int cz) {
   ZoneScoped;
+  const auto start = std::chrono::steady_clock::now();
   auto chunk = new Chunk(m_blockManager, cx, cz);
-  std::vector<float> heights(Chunk::CHUNK_SQ_SIZE);
-  std::vector<float> temps(Chunk::CHUNK_SQ_SIZE);
-  heightGenFBm->GenUniformGrid2D(heights.data(), cx * Chunk::CHUNK_SIZE, cz * Chunk::CHUNK_SIZE, Chunk::CHUNK_SIZE,
-                                 Chunk::CHUNK_SIZE, 0.005f, 1337);
-  tempNoise->GenUniformGrid2D(temps.data(), cx * Chunk::CHUNK_SIZE, cz * Chunk::CHUNK_SIZE, Chunk::CHUNK_SIZE,
-                              Chunk::CHUNK_SIZE, 0.002f, 1337);
-
-  const int maxHeight = 128;
-  const int minHeight = 45;
-  const int waterLevel = 62;
-
-  const int maxHeightInChunk =
-      static_cast<int>((*std::max_element(heights.begin(), heights.end()) + 1.0f) * (maxHeight - minHeight) / 2.0f) +
-      minHeight;
-
-  chunk->m_maxY = std::max(maxHeightInChunk, waterLevel);
-  chunk->m_voxels.resize(chunk->m_maxY * Chunk::CHUNK_SQ_SIZE);
+  generateBiomeMap(*chunk, cx, cz);
+  const BiomeMap &biomeMap = chunk->m_biomeMap;
 
-  size_t idx = 0;
+  std::vector<float> heightNoise(Chunk::CHUNK_SQ_SIZE);
+  heightGenFBm->GenUniformGrid2D(heightNoise.data(), cx * Chunk::CHUNK_SIZE, cz * Chunk::CHUNK_SIZE, Chunk::CHUNK_SIZE,
+                                 Chunk::CHUNK_SIZE, 0.005f, SEED);
+
+  std::array<int, Chunk::CHUNK_SQ_SIZE> heights;
+  std::array<int, Chunk::CHUNK_SQ_SIZE> decorationHeights{};
+  int maxHeightInChunk = WATER_LEVEL;
+  int maxStoneY = 0;
   for (int z = 0; z < Chunk::CHUNK_SIZE; ++z) {
     for (int x = 0; x < Chunk::CHUNK_SIZE; ++x) {
-      size_t activeIdx = idx++;
-      // float caveNoise = caveNoiseGen.GetNoise(static_cast<float>(cx *
-      // Chunk::WIDTH + x) / Chunk::WIDTH, static_cast<float>(cz * Chunk::WIDTH
-      // + z) / Chunk::WIDTH);
-
-      const int height = static_cast<int>((heights[activeIdx] + 1.0f) * (maxHeight - minHeight) / 2.0f) + minHeight;
-      size_t blockIdx = x + z * Chunk::CHUNK_SIZE;
-      for (int y = 0; y < std::max(height, waterLevel); ++y) {
-        size_t currentBlockIdx = blockIdx;
-        blockIdx += Chunk::CHUNK_SQ_SIZE;
-        if (y > height) {
-          chunk->m_voxels[currentBlockIdx].blockId = BlockId::Water;
-          continue;
+      const size_t columnIdx = x + z * Chunk::CHUNK_SIZE;
+      const auto &column = biomeMap.getColumn(x, z);
+      const int height = std::clamp(static_cast<int>(column.baseHeight + heightNoise[columnIdx] * column.heightScale), 1,
+                                    Chunk::CHUNK_HEIGHT - 3);
+      heights[columnIdx] = height;
+      maxStoneY = std::max(maxStoneY, height - 4);
+
+      const auto &biome = BiomeMap::getParams(column.dominantBiome);
+      if (height > WATER_LEVEL && biome.surfaceBlock == BlockId::Grass && column.decorationDensity > 0.0f) {
+        const uint64_t hash = hashColumn(cx * Chunk::CHUNK_SIZE + x, cz * Chunk::CHUNK_SIZE + z);
+        if (static_cast<float>(hash & 0xFFFF) < column.decorationDensity * 65536.0f) {
+          decorationHeights[columnIdx] = 1 + static_cast<int>((hash >> 16) & 1);
         }
-        chunk->m_voxels[currentBlockIdx].blockId = temps[activeIdx] > 0.5 ? BlockId::CoalOre : BlockId::Grass;
+      }
+      maxHeightInChunk = std::max(maxHeightInChunk, height + decorationHeights[columnIdx]);
+    }
+  }
+
+  chunk->m_maxY = maxHeightInChunk;
+  chunk->m_voxels.resize(chunk->m_maxY * Chunk::CHUNK_SQ_SIZE);
+
+  for (int z = 0; z < Chunk::CHUNK_SIZE; ++z) {
+    for (int x = 0; x < Chunk::CHUNK_SIZE; ++x) {
+      const size_t columnIdx = x + z * Chunk::CHUNK_SIZE;
+      const int height = heights[columnIdx];
+      const auto &biome = BiomeMap::getParams(biomeMap.getDominantBiome(x, z));
+      // На берегу и под водой трава превращается в песок
+      const bool isShore = height <= WATER_LEVEL + 1;
+      const BlockId surfaceBlock = isShore && biome.surfaceBlock == BlockId::Grass ? BlockId::Sand : biome.surfaceBlock;
+      const BlockId subsurfaceBlock =
+          isShore && biome.subsurfaceBlock == BlockId::Dirt ? BlockId::Sand : biome.subsurfaceBlock;
+
+      size_t blockIdx = columnIdx;
+      for (int y = 0; y < height; ++y, blockIdx += Chunk::CHUNK_SQ_SIZE) {
         if (y == 0) {
-          chunk->m_voxels[currentBlockIdx].blockId = BlockId::Bedrock;
+          chunk->m_voxels[blockIdx].blockId = BlockId::Bedrock;
         } else if (y == height - 1) {
-          chunk->m_voxels[currentBlockIdx].blockId = BlockId::Grass;
+          chunk->m_voxels[blockIdx].blockId = surfaceBlock;
         } else if (y > height - 4) {
-          chunk->m_voxels[currentBlockIdx].blockId = BlockId::Dirt;
+          chunk->m_voxels[blockIdx].blockId = subsurfaceBlock;
         } else {
-          chunk->m_voxels[currentBlockIdx].blockId = BlockId::Stone;
+          chunk->m_voxels[blockIdx].blockId = BlockId::Stone;
         }
       }
+      for (int y = height; y < WATER_LEVEL; ++y, blockIdx += Chunk::CHUNK_SQ_SIZE) {
+        chunk->m_voxels[blockIdx].blockId = BlockId::Water;
+      }
+      for (int y = 0; y < decorationHeights[columnIdx]; ++y, blockIdx += Chunk::CHUNK_SQ_SIZE) {
+        chunk->m_voxels[blockIdx].blockId = BlockId::Leaves;
+      }
     }
   }
 
+  // Камень лежит сплошным слоем от y = 1, поэтому секции с камнем идут подряд снизу
+  const uint32_t stoneSectionsMask = maxStoneY > 0 ? (2u << (maxStoneY / Chunk::SECTION_SIZE)) - 1u : 0u;
+  const auto oresStart = std::chrono::steady_clock::now();
+  placeOres(*chunk, stoneSectionsMask);
+  const auto end = std::chrono::steady_clock::now();
+  m_oresNanoseconds.fetch_add(std::chrono::nanoseconds(end - oresStart).count(), std::memory_order_relaxed);
+  m_generationNanoseconds.fetch_add(std::chrono::nanoseconds(end - start).count(), std::memory_order_relaxed);
+
+  chunk->tryTransition(ChunkState::Generating, ChunkState::Generated);
   return std::shared_ptr<Chunk>(chunk);
 }
+
+void WorldGenerator::collectOreVeins(int cx, int cz, std::vector<OreVein> &veins) const {
+  ZoneScoped;
+  SplitMix64 random(mixHash(hashColumn(cx, cz) ^ static_cast<uint64_t>(SEED)));
+  const int chunkWorldX = cx * Chunk::CHUNK_SIZE;
+  const int chunkWorldZ = cz * Chunk::CHUNK_SIZE;
+  for (const auto &ore : ORES) {
+    for (int i = 0; i < ore.veinsPerChunk; i++) {
+      veins.push_back({
+          .x = chunkWorldX + random.nextInt(0, Chunk::LAST_BLOCK_IDX),
+          .y = random.nextInt(ore.minY, ore.maxY),
+          .z = chunkWorldZ + random.nextInt(0, Chunk::LAST_BLOCK_IDX),
+          .radiusX = random.nextInt(ore.minRadius, ore.maxRadius),
+          .radiusY = random.nextInt(ore.minRadius, ore.maxRadius),
+          .radiusZ = random.nextInt(ore.minRadius, ore.maxRadius),
+          .block = ore.block,
+      });
+    }
+  }
+}
+
+void WorldGenerator::placeOres(Chunk &chunk, uint32_t stoneSectionsMask) const {
+  ZoneScoped;
+  if (stoneSectionsMask == 0) {
+    return;
+  }
+  std::vector<OreVein> veins;
+  veins.reserve(9 * 32);
+  for (int dz = -1; dz <= 1; dz++) {
+    for (int dx = -1; dx <= 1; dx++) {
+      collectOreVeins(chunk.x() + dx, chunk.z() + dz, veins);
+    }
+  }
+
+  const int chunkWorldX = chunk.worldX();
+  const int chunkWorldZ = chunk.worldZ();
+  for (const auto &vein : veins) {
+    const int minX = std::max(vein.x - vein.radiusX - chunkWorldX, 0);
+    const int maxX = std::min(vein.x + vein.radiusX - chunkWorldX, Chunk::LAST_BLOCK_IDX);
+    const int minZ = std::max(vein.z - vein.radiusZ - chunkWorldZ, 0);
+    const int maxZ = std::min(vein.z + vein.radiusZ - chunkWorldZ, Chunk::LAST_BLOCK_IDX);
+    const int minY = std::max(vein.y - vein.radiusY, 1);
+    const int maxY = std::min(vein.y + vein.radiusY, chunk.m_maxY - 1);
+    if (minX > maxX || minZ > maxZ || minY > maxY) {
+      continue;
+    }
+    const uint32_t veinSectionsMask =
+        (2u << (maxY / Chunk::SECTION_SIZE)) - (1u << (minY / Chunk::SECTION_SIZE));
+    if ((veinSectionsMask & stoneSectionsMask) == 0) {
+      continue;
+    }
+
+    const float invRadiusX = 1.0f / (static_cast<float>(vein.radiusX) + 0.5f);
+    const float invRadiusY = 1.0f / (static_cast<float>(vein.radiusY) + 0.5f);
+    const float invRadiusZ = 1.0f / (static_cast<float>(vein.radiusZ) + 0.5f);
+    for (int y = minY; y <= maxY; y++) {
+      const float ny = static_cast<float>(y - vein.y) * invRadiusY;
+      for (int z = minZ; z <= maxZ; z++) {
+        const float nz = static_cast<float>(z + chunkWorldZ - vein.z) * invRadiusZ;
+        for (int x = minX; x <= maxX; x++) {
+          const float nx = static_cast<float>(x + chunkWorldX - vein.x) * invRadiusX;
+          if (nx * nx + ny * ny + nz * nz > 1.0f) {
+            continue;
+          }
+          auto &voxel = chunk.m_voxels[chunk.getIdxFromCoords(x, y, z)];
+          if (voxel.blockId == BlockId::Stone) {
+            voxel.blockId = vein.block;
+          }
+        }
+      }
+    }
+  }
+}
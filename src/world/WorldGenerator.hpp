@@ -3,17 +3,52 @@
 #include "BlocksManager.hpp"
 #include "Chunk.hpp"
 #include <FastNoise/FastNoise.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
 
 class WorldGenerator {
 public:
+  // Время генерации всех чанков по всем потокам и его часть на размещение руд
+  struct Stats {
+    std::chrono::nanoseconds generationTime;
+    std::chrono::nanoseconds oresTime;
+  };
+
   WorldGenerator(BlocksManager &blockManager);
 
   std::shared_ptr<Chunk> generateChunk(int cx, int cz);
+  inline Stats getStats() const noexcept {
+    return {std::chrono::nanoseconds(m_generationNanoseconds.load(std::memory_order_relaxed)),
+            std::chrono::nanoseconds(m_oresNanoseconds.load(std::memory_order_relaxed))};
+  }
 
 private:
+  struct OreVein {
+    int x;
+    int y;
+    int z;
+    int radiusX;
+    int radiusY;
+    int radiusZ;
+    BlockId block;
+  };
+
+  void generateBiomeMap(Chunk &chunk, int cx, int cz);
+  void collectOreVeins(int cx, int cz, std::vector<OreVein> &veins) const;
+  void placeOres(Chunk &chunk, uint32_t stoneSectionsMask) const;
+
+private:
+  static constexpr int SEED = 1337;
+  static constexpr int WATER_LEVEL = 62;
+
   FastNoise::SmartNode<FastNoise::OpenSimplex2> heightGenNoise;
   FastNoise::SmartNode<FastNoise::FractalFBm> heightGenFBm;
   FastNoise::SmartNode<FastNoise::OpenSimplex2> tempNoise;
+  FastNoise::SmartNode<FastNoise::OpenSimplex2> humidityNoise;
   FastNoise::SmartNode<> node;
   BlocksManager &m_blockManager;
+  std::atomic<int64_t> m_generationNanoseconds = 0;
+  std::atomic<int64_t> m_oresNanoseconds = 0;
 };